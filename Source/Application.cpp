@@ -4,182 +4,1289 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 
+#include "Validation/GoldenImage.h"
+
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <fstream>
 #include <iostream>
 #include <string>
 
 #define MAX_LIGHTS 992
+// Uniform buffer binding point of the light positions.
+#define LIGHTS_UNIFORM_BINDING 0
+// Shaders drawn side by side in demo scene, the rest is selectable in research scene only.
+#define DEMO_SPHERES 6
+// Grid of spheres in materials scene.
+#define MATERIAL_COLUMNS 8
+#define MATERIAL_ROWS 4
+// Chrome trace written by the CPU profiler, open in chrome://tracing or ui.perfetto.dev.
+#define CPU_TRACE_FILE "cpu_trace.json"
+// Frames drawn after input in render on demand mode, ImGui needs a few to settle hover and focus.
+#define REDRAW_FRAMES 3
+// Longest wait for events in render on demand mode, loads in progress are checked at least this often.
+#define REDRAW_TIMEOUT 0.1
+// Resolution of golden images.
+#define GOLDEN_WIDTH 640
+#define GOLDEN_HEIGHT 360
+// Camera path saved and loaded from the GUI when no --camera-path is given.
+#define CAMERA_PATH_FILE "camera_path.txt"
 
 Application* Application::Instance = nullptr;
 
-Application::Application()
-	:Camera(glm::vec3(0.0f, -1.0f, -8.f), glm::vec2(ScreenWidth / 2, ScreenHeight / 2))
+namespace
 {
-	Instance = this;
+	// Children of Parent as tree with time per frame and share of the frame.
+	void DrawCpuSummary(const std::vector<FCpuSummaryNode>& Nodes, int Parent, float FrameTime)
+	{
+		for (size_t i = 0; i < Nodes.size(); ++i)
+		{
+			const FCpuSummaryNode& Node = Nodes[i];
+			if (Node.Parent != Parent)
+			{
+				continue;
+			}
+
+			const bool bLeaf = std::none_of(Nodes.begin(), Nodes.end(), [i](const FCpuSummaryNode& Child) { return Child.Parent == int(i); });
+			const ImGuiTreeNodeFlags Flags = ImGuiTreeNodeFlags_DefaultOpen | (bLeaf ? ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen : 0);
+
+			const bool bOpen = ImGui::TreeNodeEx((void*)(intptr_t)i, Flags, "%s : %.3f ms (%.0f%%), %.1f calls",
+				Node.Name.c_str(), Node.Average, FrameTime > 0.f ? Node.Average / FrameTime * 100.f : 0.f, Node.Calls);
+			if (bOpen && !bLeaf)
+			{
+				DrawCpuSummary(Nodes, int(i), FrameTime);
+				ImGui::TreePop();
+			}
+		}
+	}
+
+	struct FGoldenView
+	{
+		glm::vec3 Position;
+		double Yaw;
+		double Pitch;
+	};
+
+	// Canonical views of golden images : front, close up with grazing light and from above the side.
+	const std::array<FGoldenView, 3> GoldenViews = { {
+		{ glm::vec3(0.f, -1.f, -8.f), 90., 0. },
+		{ glm::vec3(0.f, -0.5f, -3.f), 90., 5. },
+		{ glm::vec3(4.f, 2.f, -4.f), 135., -19.5 },
+	} };
+
+	// Texture set bound by a draw, part of its sort key.
+	enum class EMaterialSet
+	{
+		EUntextured,
+		ESphereTextures,
+		EMaterialArrays,
+	};
+
+	const char* GetSceneName(EScene Scene)
+	{
+		switch (Scene)
+		{
+		case EScene::EDemo:
+			return "Demo";
+		case EScene::EStudy:
+			return "Study";
+		case EScene::EMaterials:
+			return "Materials";
+		}
+		return "";
+	}
+
+	// Shader permutation defines, MAX_LIGHTS and the light backend are shared by all of them.
+	std::vector<std::string> GetShaderDefines(std::initializer_list<const char*> Features)
+	{
+		std::vector<std::string> Defines(Features.begin(), Features.end());
+		Defines.push_back("MAX_LIGHTS " + std::to_string(MAX_LIGHTS));
+		Defines.push_back("LIGHTS_UNIFORM_BUFFER");
+		return Defines;
+	}
+
+	// Replaces one of two alternative defines by the other, shaders with neither are left alone.
+	void SelectDefine(FShader& Shader, const char* Enabled, const char* Disabled, bool bEnable)
+	{
+		if (Shader.HasDefine(Enabled) || Shader.HasDefine(Disabled))
+		{
+			Shader.SetDefine(bEnable ? Disabled : Enabled, false);
+			Shader.SetDefine(bEnable ? Enabled : Disabled, true);
+		}
+	}
+}
 
-	Shaders.reserve(6);
+Application::Application(const FApplicationOptions& inOptions)
+	:Options(inOptions),
+	InstancedShader("PBR with texture array", "Source/Shaders/_vs.glsl", "Source/Shaders/pbr_fs.glsl", true, GetShaderDefines({ "TEXTURED", "TEXTURE_ARRAY", "FRESNEL_COOK_TORRANCE" })),
+	DepthShader("Depth Pre-Pass", "Source/Shaders/depth_vs.glsl", "Source/Shaders/depth_fs.glsl"),
+	DepthInstancedShader("Depth Pre-Pass instanced", "Source/Shaders/depth_vs.glsl", "Source/Shaders/depth_fs.glsl", true, { "TEXTURE_ARRAY" }),
+	Camera(glm::vec3(0.0f, -1.0f, -8.f), glm::vec2(ScreenWidth / 2, ScreenHeight / 2))
+{
+	Instance = this;
 
-	Shaders.emplace_back("Gouraud", "Source/Shaders/gouraud_vs.glsl", "Source/Shaders/gouraud_fs.glsl");
-	Shaders.emplace_back("BlinnPhong", "Source/Shaders/_vs.glsl", "Source/Shaders/blinn_phong_fs.glsl");
-	Shaders.emplace_back("PBR", "Source/Shaders/_vs.glsl", "Source/Shaders/pbr_fs.glsl");
-	Shaders.emplace_back("Gouraud with texture", "Source/Shaders/gouraud_tex_vs.glsl", "Source/Shaders/gouraud_fs.glsl");
-	Shaders.emplace_back("BlinnPhong with texture", "Source/Shaders/_vs.glsl", "Source/Shaders/blinn_phong_tex_fs.glsl");
-	Shaders.emplace_back("PBR with texture", "Source/Shaders/_vs.glsl", "Source/Shaders/pbr_tex_fs.glsl");
+	Shaders.reserve(7);
+
+	// Untextured Gouraud and BlinnPhong are tuned for direct display output, the rest write linear color.
+	Shaders.emplace_back("Gouraud", "Source/Shaders/gouraud_vs.glsl", "Source/Shaders/gouraud_fs.glsl", false, GetShaderDefines({}));
+	Shaders.emplace_back("BlinnPhong", "Source/Shaders/_vs.glsl", "Source/Shaders/blinn_phong_fs.glsl", false, GetShaderDefines({}));
+	Shaders.emplace_back("PBR", "Source/Shaders/_vs.glsl", "Source/Shaders/pbr_fs.glsl", true, GetShaderDefines({ "FRESNEL_COOK_TORRANCE" }));
+	Shaders.emplace_back("Gouraud with texture", "Source/Shaders/gouraud_vs.glsl", "Source/Shaders/gouraud_fs.glsl", true, GetShaderDefines({ "TEXTURED" }));
+	Shaders.emplace_back("BlinnPhong with texture", "Source/Shaders/_vs.glsl", "Source/Shaders/blinn_phong_fs.glsl", true, GetShaderDefines({ "TEXTURED" }));
+	Shaders.emplace_back("PBR with texture", "Source/Shaders/_vs.glsl", "Source/Shaders/pbr_fs.glsl", true, GetShaderDefines({ "TEXTURED", "FRESNEL_COOK_TORRANCE" }));
+	// Same as above with tangent frame from vertex attributes instead of screen space derivatives.
+	Shaders.emplace_back("PBR with texture and vertex tangents", "Source/Shaders/_vs.glsl", "Source/Shaders/pbr_fs.glsl", true, GetShaderDefines({ "TEXTURED", "VERTEX_TANGENTS", "FRESNEL_COOK_TORRANCE" }));
+
+	Scene = Options.Scene;
+	bRenderOnDemand = Options.bRenderOnDemand;
+	LightsColumns = Options.LightsColumns >= 0 ? Options.LightsColumns : LightsColumns;
+	LightsRows = Options.LightsRows >= 0 ? Options.LightsRows : LightsRows;
+	SphereSegments = Options.SphereSegments > 0 ? Options.SphereSegments : SphereSegments;
+	AppliedSphereSegments = SphereSegments;
+	DepthPrepass[int(Scene)] = Options.bDepthPrepass;
+	bDynamicResolution = Options.bDynamicResolution;
+	TargetFrameTime = Options.TargetFrameTime;
+	if (Options.IsHeadless())
+	{
+		// Golden images do not depend on the benchmark resolution.
+		ScreenWidth = Options.bBenchmark ? Options.BenchmarkWidth : GOLDEN_WIDTH;
+		ScreenHeight = Options.bBenchmark ? Options.BenchmarkHeight : GOLDEN_HEIGHT;
+		// Only the measured shaders are compiled.
+		bPrewarmShaders = false;
+	}
 
 	Init();
 }
 
-void Application::Init()
+void Application::Init()
+{
+	if (!glfwInit())
+	{
+		std::cout << "Failed to initialize GLFW" << std::endl;
+		return;
+	}
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE);
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, Options.bDebugContext ? GLFW_TRUE : GLFW_FALSE);
+	glfwWindowHint(GLFW_VISIBLE, Options.IsHeadless() ? GLFW_FALSE : GLFW_TRUE);
+	glfwWindowHint(GLFW_CONTEXT_CREATION_API,
+		Options.ContextApi == EContextApi::EEGL ? GLFW_EGL_CONTEXT_API :
+		Options.ContextApi == EContextApi::EOSMesa ? GLFW_OSMESA_CONTEXT_API : GLFW_NATIVE_CONTEXT_API);
+
+	Window = glfwCreateWindow(ScreenWidth, ScreenHeight, "PBR", NULL, NULL);
+	if (!Window)
+	{
+		std::cout << "Failed to create GLFW Window" << std::endl;
+		glfwTerminate();
+		return;
+	}
+
+	// Headless contexts may have no monitor.
+	const GLFWvidmode* mode = glfwGetPrimaryMonitor() ? glfwGetVideoMode(glfwGetPrimaryMonitor()) : nullptr;
+	if (!Options.IsHeadless() && mode)
+	{
+		glfwSetWindowMonitor(Window, nullptr, 96, 50, ScreenWidth, ScreenHeight, mode->refreshRate);
+	}
+
+	glfwMakeContextCurrent(Window);
+
+	glfwSetFramebufferSizeCallback(Window, &Application::_FramebufferSizeCallback);
+	glfwSetKeyCallback(Window, &Application::_KeyCallback);
+	glfwSetScrollCallback(Window, &Application::_ScrollCallback);
+	glfwSetCursorPosCallback(Window, &Application::_CursorPosCallback);
+	glfwSetMouseButtonCallback(Window, &Application::_MouseButtonCallback);
+	glfwSetWindowRefreshCallback(Window, &Application::_WindowRefreshCallback);
+
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		glfwTerminate();
+		return;
+	}
+
+	if (Options.bDebugContext && !DebugOutput.Init())
+	{
+		std::cout << "KHR_debug is not supported, performance warnings are not available" << std::endl;
+	}
+
+	bInitialized = true;
+}
+
+int Application::Run()
+{
+	if (!bInitialized)
+	{
+		return 1;
+	}
+
+	CPU_THREAD_NAME("Main");
+
+	Begin();
+
+	int Result = 0;
+	if (Options.bBenchmark)
+	{
+		Result = RunBenchmark();
+	}
+	else if (Options.GoldenMode != EGoldenMode::ENone)
+	{
+		Result = RunGoldenImages();
+	}
+	else
+	{
+		// Render thread takes over the context, window events stay on the main thread as GLFW requires.
+		if (!Options.bSingleThreaded)
+		{
+			glfwMakeContextCurrent(nullptr);
+			RenderThread = std::thread(&Application::RenderLoop, this);
+		}
+
+		while (!glfwWindowShouldClose(Window))
+		{
+			CPU_FRAME();
+
+			{
+				CPU_SCOPE("glfwPollEvents");
+				glfwPollEvents();
+			}
+			UpdateCamera();
+
+			if (bRenderOnDemand && !IsRedrawNeeded())
+			{
+				// Nothing changed, previous frame stays on screen.
+				++FramesSkipped;
+
+				CPU_SCOPE("glfwWaitEventsTimeout");
+				glfwWaitEventsTimeout(REDRAW_TIMEOUT);
+				continue;
+			}
+
+			std::unique_ptr<FFramePacket> Packet = BuildFrame();
+			if (RenderThread.joinable())
+			{
+				// Waits while the render thread is a full queue behind.
+				CPU_SCOPE("FrameQueue.Push");
+				FrameQueue.Push(std::move(Packet));
+			}
+			else
+			{
+				Draw(*Packet);
+				FrameQueue.Release(std::move(Packet));
+			}
+		}
+
+		if (RenderThread.joinable())
+		{
+			FrameQueue.Stop();
+			RenderThread.join();
+			glfwMakeContextCurrent(Window);
+		}
+	}
+
+	End();
+	return Result;
+}
+
+int Application::RunBenchmark()
+{
+	FRenderTarget Target;
+	if (!Target.Init(ScreenWidth, ScreenHeight))
+	{
+		std::cout << "Failed to create " << ScreenWidth << "x" << ScreenHeight << " benchmark framebuffer" << std::endl;
+		return 1;
+	}
+	Target.Bind();
+
+	if (!Options.CameraPath.empty() && !CameraPath.Load(Options.CameraPath))
+	{
+		std::cout << "Failed to load camera path " << Options.CameraPath << std::endl;
+		return 1;
+	}
+
+	const int Frames = Options.WarmupFrames + Options.BenchmarkFrames;
+	std::vector<GLuint> Queries(Frames);
+	glGenQueries(Frames, Queries.data());
+	std::vector<double> CpuTimes(Frames);
+
+	for (int i = 0; i < Frames; ++i)
+	{
+		CPU_FRAME();
+
+		// Warm-up frames look from the start of the path, measured frames follow it at fixed timestep.
+		if (i == 0)
+		{
+			CameraPath.Evaluate(0., Camera);
+		}
+		if (i == Options.WarmupFrames)
+		{
+			CameraPath.StartPlayback();
+		}
+		CameraPath.Step(Camera);
+
+		const int64_t FrameBegin = FCpuProfiler::Now();
+		glBeginQuery(GL_TIME_ELAPSED, Queries[i]);
+		Draw(*BuildFrame());
+		glEndQuery(GL_TIME_ELAPSED);
+		CpuTimes[i] = double(FCpuProfiler::Now() - FrameBegin) / 1e6;
+	}
+
+	// Results of all the frames are read at the end, so reading does not stall the measured frames.
+	glFinish();
+	std::vector<GLuint64> GpuTimes(Frames);
+	for (int i = 0; i < Frames; ++i)
+	{
+		glGetQueryObjectui64v(Queries[i], GL_QUERY_RESULT, &GpuTimes[i]);
+	}
+	glDeleteQueries(Frames, Queries.data());
+
+	// Times of a broken run are not comparable, so no results are written.
+	bool bFailed = false;
+	for (FShader* Shader : GetShaders())
+	{
+		if (Shader->IsReady() && Shader->GetID() == 0)
+		{
+			std::cout << "Shader " << Shader->GetName() << " failed to compile" << std::endl;
+			bFailed = true;
+		}
+	}
+	const GLenum Error = glGetError();
+	if (Error != GL_NO_ERROR)
+	{
+		std::cout << "OpenGL error 0x" << std::hex << Error << std::dec << std::endl;
+		bFailed = true;
+	}
+	if (bFailed)
+	{
+		std::cout << "Benchmark failed, " << Options.BenchmarkOutput << " not written" << std::endl;
+		return 1;
+	}
+
+	std::ofstream File(Options.BenchmarkOutput);
+	if (!File)
+	{
+		std::cout << "Failed to write " << Options.BenchmarkOutput << std::endl;
+		return 1;
+	}
+
+	const std::string ShaderName = Scene == EScene::EStudy && ShaderOne ? ShaderOne->GetName() :
+		Scene == EScene::EMaterials ? InstancedShader.GetName() : "All";
+	std::string Renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+	std::replace(Renderer.begin(), Renderer.end(), '"', '\'');
+
+	File << "frame,scene,shader,lights,segments,depth_prepass,width,height,cpu_ms,gpu_ms,renderer\n";
+	for (int i = Options.WarmupFrames; i < Frames; ++i)
+	{
+		File << i - Options.WarmupFrames << ","
+			<< GetSceneName(Scene) << ","
+			<< "\"" << ShaderName << "\","
+			<< LightsColumns * LightsRows << ","
+			<< SphereSegments << ","
+			<< (DepthPrepass[int(Scene)] ? 1 : 0) << ","
+			<< ScreenWidth << "," << ScreenHeight << ","
+			<< CpuTimes[i] << ","
+			<< double(GpuTimes[i]) / 1e6 << ","
+			<< "\"" << Renderer << "\"\n";
+	}
+
+	std::cout << "Wrote " << Options.BenchmarkFrames << " frames of " << ShaderName << " on " << Renderer
+		<< " to " << Options.BenchmarkOutput << std::endl;
+
+	return 0;
+}
+
+void Application::Begin()
+{
+	{
+		IMGUI_CHECKVERSION();
+		ImGui::CreateContext();
+		ImGui::StyleColorsDark();
+		ImGui_ImplGlfw_InitForOpenGL(Window, true);
+		ImGui_ImplOpenGL3_Init("#version 330");
+		// Creates font texture and device objects while the main thread has the context, the render thread only draws.
+		ImGui_ImplOpenGL3_NewFrame();
+
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LESS);
+	}
+
+	{
+		Sphere.Init(SphereSegments);
+		BuiltSphereSegments = SphereSegments;
+		// Virtual texturing starts disabled.
+		Sphere.LoadTextures();
+
+		Projection = glm::perspective(glm::radians(60.0f), (float)ScreenWidth / ScreenHeight, 0.01f, 10000.0f);
+
+		// Shaders are compiled on first use, so the first frame waits only for the ones it draws.
+		// The rest is prewarmed during the following frames, compiled by the driver in parallel if supported.
+		FShader::EnableParallelCompile();
+		ShadersStartTime = glfwGetTime();
+		PendingShaders = int(GetShaders().size());
+
+		ShaderOne = &Shaders[Options.Shader >= 0 && Options.Shader < int(Shaders.size()) ? Options.Shader : 5];
+
+		// Edited shaders are recompiled while running.
+		if (!Options.IsHeadless())
+		{
+			ShaderWatcher.Start("Source/Shaders");
+		}
+
+		GpuProfiler.Init();
+	}
+
+	{
+		// Every material has to have maps of the same size.
+		Sphere.InitMaterials({ "Textures/rustediron2" });
+
+		std::vector<glm::vec4> Instances;
+		for (int j = 0; j < MATERIAL_ROWS; ++j)
+		{
+			for (int i = 0; i < MATERIAL_COLUMNS; ++i)
+			{
+				Instances.emplace_back(
+					(MATERIAL_COLUMNS - 1) * 2.5f / 2.f - 2.5f * i,
+					(MATERIAL_ROWS - 1) * 2.5f / 2.f - 2.5f * j,
+					0.f,
+					float(Instances.size() % std::max(Sphere.GetMaterialsNum(), 1)));
+			}
+		}
+		Sphere.SetInstances(Instances);
+	}
+
+	// First frames are drawn before any input.
+	RequestRedraw();
+}
+
+void Application::End()
+{
+	ShaderWatcher.Stop();
+	GpuProfiler.Shutdown();
+	DebugOutput.Shutdown();
+	VirtualTextures.Shutdown();
+	SceneTarget.Shutdown();
+	if (LightsUBO)
+	{
+		FStateCache::Get().DeleteBuffers(1, &LightsUBO);
+		LightsUBO = 0;
+	}
+
+	ImGui_ImplOpenGL3_Shutdown();
+	ImGui_ImplGlfw_Shutdown();
+	ImGui::DestroyContext();
+
+	glfwTerminate();
+}
+
+int Application::RunGoldenImages()
+{
+	// Float target keeps the exact output, linear color is encoded on CPU.
+	FRenderTarget Target;
+	if (!Target.Init(ScreenWidth, ScreenHeight, GL_RGBA32F))
+	{
+		std::cout << "Failed to create " << ScreenWidth << "x" << ScreenHeight << " float framebuffer" << std::endl;
+		return 1;
+	}
+	Target.Bind();
+
+	FGoldenImages Golden(Options.GoldenDirectory, Options.GoldenMode == EGoldenMode::ECapture);
+	std::vector<float> Pixels(size_t(ScreenWidth) * ScreenHeight * 4);
+
+	int Result = 0;
+	for (FShader* Shader : GetShaders())
+	{
+		// Depth only, drawn as part of the scene with the pre-pass.
+		if (Shader == &DepthShader || Shader == &DepthInstancedShader)
+		{
+			continue;
+		}
+
+		const bool bInstanced = Shader == &InstancedShader;
+		Scene = bInstanced ? EScene::EMaterials : EScene::EStudy;
+		ShaderOne = bInstanced ? ShaderOne : Shader;
+
+		std::string Name = Shader->GetName();
+		std::replace(Name.begin(), Name.end(), ' ', '_');
+
+		for (size_t View = 0; View < GoldenViews.size(); ++View)
+		{
+			Camera.SetPose(GoldenViews[View].Position, GoldenViews[View].Yaw, GoldenViews[View].Pitch);
+			Draw(*BuildFrame());
+
+			glReadPixels(0, 0, ScreenWidth, ScreenHeight, GL_RGBA, GL_FLOAT, Pixels.data());
+			Golden.Process(Name + "_view" + std::to_string(View), FImage::FromFramebuffer(ScreenWidth, ScreenHeight, Pixels, Shader->IsLinearOutput()));
+		}
+
+		if (Shader->GetID() == 0)
+		{
+			std::cout << "Shader " << Shader->GetName() << " failed to compile" << std::endl;
+			Result = 1;
+		}
+	}
+
+	return Golden.Finish() == 0 ? Result : 1;
+}
+
+void Application::UpdateCamera()
+{
+	if (CameraPath.IsPlaying())
+	{
+		CameraPath.Step(Camera);
+		return;
+	}
+
+	const glm::mat4 PreviousView = Camera.GetView();
+	{
+		CPU_SCOPE("Camera.ProcessInput");
+		Camera.ProcessInput(Window);
+	}
+	CameraPath.Record(glfwGetTime(), Camera);
+
+	if (Camera.GetView() != PreviousView)
+	{
+		RequestRedraw();
+	}
+}
+
+void Application::RequestRedraw()
+{
+	RedrawFrames = REDRAW_FRAMES;
+}
+
+bool Application::IsRedrawNeeded() const
+{
+	// Edited shaders are picked up by the render thread during the next frame.
+	return RedrawFrames > 0 || CameraPath.IsPlaying() || bRenderBusy || ShaderWatcher.HasChanges();
+}
+
+std::unique_ptr<FFramePacket> Application::BuildFrame()
+{
+	CPU_SCOPE("BuildFrame");
+
+	{
+		std::lock_guard<std::mutex> Lock(StatsMutex);
+		Stats = PublishedStats;
+	}
+	if (Stats.VirtualTexturingFailures != SeenVirtualTexturingFailures)
+	{
+		SeenVirtualTexturingFailures = Stats.VirtualTexturingFailures;
+		bEnableVirtualTexturing = false;
+	}
+
+	std::unique_ptr<FFramePacket> Packet = FrameQueue.Acquire();
+
+	Packet->View = Camera.GetView();
+	Packet->CameraPosition = Camera.GetPosition();
+
+	for (int j = 0; j < LightsRows; ++j)
+	{
+		for (int i = 0; i < LightsColumns; ++i)
+		{
+			Packet->LightPositions.emplace_back(
+				LightsOffset +
+				glm::vec3(
+					(LightsColumns - 1) * IntervalBetweenLights / 2.f - IntervalBetweenLights * i,
+					(LightsRows - 1) * IntervalBetweenLights / 2.f - IntervalBetweenLights * j,
+					0.f));
+		}
+	}
+
+	Packet->Metallic = Metallic;
+	Packet->Roughness = Roughness;
+	Packet->Albedo = Albedo;
+	Packet->bDepthPrepass = DepthPrepass[int(Scene)];
+	// Headless modes measure the native resolution.
+	Packet->bDynamicResolution = bDynamicResolution && !Options.IsHeadless();
+	Packet->TargetFrameTime = TargetFrameTime;
+
+	// Shader index stands for the program, its GL name belongs to the render thread.
+	auto AddDraw = [this, &Packet](size_t Index, float Offset)
+	{
+		FDrawItem Item;
+		Item.Shader = Index < Shaders.size() ? &Shaders[Index] : &InstancedShader;
+		Item.bInstanced = Item.Shader == &InstancedShader;
+		Item.Offset = Offset;
+
+		// Shaders from the fourth on are textured.
+		const EMaterialSet Material = Item.bInstanced ? EMaterialSet::EMaterialArrays :
+			Index >= 3 ? EMaterialSet::ESphereTextures : EMaterialSet::EUntextured;
+		const float Depth = -(Packet->View * glm::vec4(Offset, 0.f, 0.f, 1.f)).z;
+		Item.SortKey = FDrawList::MakeKey(EDrawPass::EOpaque, uint32_t(Index), uint32_t(Material), Depth);
+
+		Packet->Draws.Add(Item);
+
+		// Same geometry again with the position only shader, program 1 is the instanced one.
+		if (Packet->bDepthPrepass)
+		{
+			Item.Pass = EDrawPass::EDepthPrepass;
+			Item.SortKey = FDrawList::MakeKey(EDrawPass::EDepthPrepass, Item.bInstanced ? 1 : 0, 0, Depth);
+			Packet->Draws.Add(Item);
+		}
+	};
+
+	switch (Scene)
+	{
+	case EScene::EDemo:
+		for (size_t i = 0; i < DEMO_SPHERES; ++i)
+		{
+			AddDraw(i, GetSphereOffset(i));
+		}
+		break;
+	case EScene::EStudy:
+		if (ShaderOne)
+		{
+			AddDraw(size_t(ShaderOne - Shaders.data()), 0.f);
+		}
+		break;
+	case EScene::EMaterials:
+		AddDraw(Shaders.size(), 0.f);
+		break;
+	}
+
+	{
+		CPU_SCOPE("DrawList.Sort");
+		Packet->Draws.Sort();
+	}
+
+	Packet->SphereSegments = AppliedSphereSegments;
+	Packet->bVirtualTexturing = bEnableVirtualTexturing;
+	Packet->bPrewarmShaders = bPrewarmShaders;
+	Packet->bFresnelSchlick = bUseFresnelSchlick;
+	Packet->bLightsUniformBuffer = bUseLightsUniformBuffer;
+
+	if (Options.IsHeadless())
+	{
+		Packet->FramebufferWidth = ScreenWidth;
+		Packet->FramebufferHeight = ScreenHeight;
+	}
+	else
+	{
+		glfwGetFramebufferSize(Window, &Packet->FramebufferWidth, &Packet->FramebufferHeight);
+
+		DrawGUI();
+		Packet->Gui.Copy(ImGui::GetDrawData());
+	}
+
+	// Render thread may request more frames meanwhile.
+	int Frames = RedrawFrames;
+	while (Frames > 0 && !RedrawFrames.compare_exchange_weak(Frames, Frames - 1))
+	{
+	}
+
+	return Packet;
+}
+
+void Application::RenderLoop()
+{
+	CPU_THREAD_NAME("Render");
+
+	glfwMakeContextCurrent(Window);
+
+	std::unique_ptr<FFramePacket> Packet;
+	while (FrameQueue.Pop(Packet))
+	{
+		Draw(*Packet);
+		FrameQueue.Release(std::move(Packet));
+	}
+
+	glfwMakeContextCurrent(nullptr);
+}
+
+void Application::Draw(FFramePacket& inFrame)
+{
+	CPU_SCOPE("Draw");
+
+	Frame = &inFrame;
+	FStateCache::Get().BeginFrame();
+
+	ApplyFrameSettings();
+	ReloadShaders();
+	UpdateShaders();
+
+	GpuProfiler.BeginFrame();
+	{
+		FGpuScope FrameScope(GpuProfiler, "Frame");
+
+		glViewport(0, 0, inFrame.FramebufferWidth, inFrame.FramebufferHeight);
+
+		if (bVirtualTexturing)
+		{
+			{
+				CPU_SCOPE("VirtualTextures.Update");
+				VirtualTextures.Update();
+			}
+
+			FGpuScope Scope(GpuProfiler, "Virtual Texture Feedback");
+			DrawVirtualTextureFeedback();
+		}
+
+		const bool bScaled = BeginDynamicResolution();
+
+		{
+			// Part of the frame drawn at the dynamic resolution.
+			FGpuScope Scope(GpuProfiler, "Scene");
+
+			glClearColor(0.f, 0.f, 0.f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			DrawScene();
+		}
+
+		if (bScaled)
+		{
+			EndDynamicResolution();
+		}
+
+		if (ImDrawData* GuiData = inFrame.Gui.Get())
+		{
+			CPU_SCOPE("ImGui Render");
+			FGpuScope Scope(GpuProfiler, "ImGui");
+
+			// ImGui colors are already in sRGB.
+			glDisable(GL_FRAMEBUFFER_SRGB);
+			ImGui_ImplOpenGL3_RenderDrawData(GuiData);
+		}
+	}
+
+	if (Options.IsHeadless())
+	{
+		// Hidden window is never presented.
+		glFlush();
+	}
+	else
+	{
+		CPU_SCOPE("glfwSwapBuffers");
+		glfwSwapBuffers(Window);
+	}
+
+	if (FirstFrameTime == 0.f)
+	{
+		FirstFrameTime = float((glfwGetTime() - ShadersStartTime) * 1000.);
+	}
+
+	// Headless modes have no GUI, skipping keeps the measured frames lean.
+	if (!Options.IsHeadless())
+	{
+		PublishStats();
+	}
+
+	Frame = nullptr;
+}
+
+void Application::ApplyFrameSettings()
+{
+	if (Frame->SphereSegments != BuiltSphereSegments)
+	{
+		Sphere.Init(Frame->SphereSegments);
+		BuiltSphereSegments = Frame->SphereSegments;
+	}
+
+	// Feature defines switch permutation of every shader having them, ones being compiled switch once they are ready.
+	if (Frame->bFresnelSchlick != bFresnelSchlick || Frame->bLightsUniformBuffer != bLightsUniformBuffer)
+	{
+		bFresnelSchlick = Frame->bFresnelSchlick;
+		bLightsUniformBuffer = Frame->bLightsUniformBuffer;
+		for (FShader* Shader : GetShaders())
+		{
+			if (Shader->IsReady() || !Shader->IsSubmitted())
+			{
+				UpdateShaderPermutation(*Shader);
+			}
+		}
+	}
+
+	if (Frame->bVirtualTexturing == bVirtualTexturingRequested)
+	{
+		return;
+	}
+	bVirtualTexturingRequested = Frame->bVirtualTexturing;
+
+	// Only one of full and virtual textures is resident, so texture memory stays bounded by the atlases.
+	if (bVirtualTexturingRequested && !VirtualTextures.IsInitialized())
+	{
+		if (VirtualTextures.Init({
+			"Textures/rustediron2_albedo.png",
+			"Textures/rustediron2_normal.png",
+			"Textures/rustediron2_metallic.png",
+			"Textures/rustediron2_roughness.png" },
+			Frame->FramebufferWidth, Frame->FramebufferHeight))
+		{
+			VirtualTextures.GetFeedbackShader().SetMat4("Projection", Projection);
+			Sphere.ReleaseTextures();
+		}
+		else
+		{
+			++VirtualTexturingFailures;
+		}
+	}
+	else if (!bVirtualTexturingRequested && VirtualTextures.IsInitialized())
+	{
+		VirtualTextures.Shutdown();
+		Sphere.LoadTextures();
+	}
+	bVirtualTexturing = bVirtualTexturingRequested && VirtualTextures.IsInitialized();
+
+	// Sampling path is compiled in, so textured shaders switch permutation.
+	// Ones being compiled switch once they are ready.
+	for (auto& Shad : Shaders)
+	{
+		if (Shad.IsReady() || !Shad.IsSubmitted())
+		{
+			UpdateShaderPermutation(Shad);
+		}
+	}
+}
+
+bool Application::BeginDynamicResolution()
+{
+	const int Width = Frame->FramebufferWidth;
+	const int Height = Frame->FramebufferHeight;
+	SceneWidth = Width;
+	SceneHeight = Height;
+
+	// Minimized window has no framebuffer.
+	if (!Frame->bDynamicResolution || Width <= 0 || Height <= 0)
+	{
+		DynamicResolution.Reset();
+		return false;
+	}
+
+	// Failed size is not retried every frame, only after the window is resized.
+	if (FailedSceneWidth == Width && FailedSceneHeight == Height)
+	{
+		return false;
+	}
+	if (SceneTarget.GetFBO() == 0 || SceneTarget.GetWidth() != Width || SceneTarget.GetHeight() != Height)
+	{
+		if (!SceneTarget.Init(Width, Height))
+		{
+			std::cout << "Failed to create " << Width << "x" << Height << " scene target, dynamic resolution is off at this size" << std::endl;
+			FailedSceneWidth = Width;
+			FailedSceneHeight = Height;
+			return false;
+		}
+		FailedSceneWidth = FailedSceneHeight = 0;
+	}
+
+	// Only the scene scales, so it gets what the other passes leave of the target frame time.
+	// Times are read back GPU_PROFILER_LATENCY frames late.
+	const float SceneTime = GpuProfiler.GetLast("Scene");
+	const float FixedTime = std::max(GpuProfiler.GetLast("Frame") - SceneTime, 0.f);
+	// Passes over the target alone drive the scale to the minimum.
+	const float SceneBudget = std::max(Frame->TargetFrameTime - FixedTime, Frame->TargetFrameTime * 0.01f);
+	const float Scale = DynamicResolution.Update(SceneTime, SceneBudget);
+	SceneWidth = std::max(1, int(Width * Scale));
+	SceneHeight = std::max(1, int(Height * Scale));
+
+	// Target keeps the full size, only its corner is drawn.
+	SceneTarget.Bind();
+	glViewport(0, 0, SceneWidth, SceneHeight);
+	return true;
+}
+
+void Application::EndDynamicResolution()
+{
+	CPU_SCOPE("Upscale");
+	FGpuScope Scope(GpuProfiler, "Upscale");
+
+	// Both framebuffers are sRGB, values are copied and filtered as encoded.
+	glDisable(GL_FRAMEBUFFER_SRGB);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, SceneTarget.GetFBO());
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, SceneWidth, SceneHeight, 0, 0, Frame->FramebufferWidth, Frame->FramebufferHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, Frame->FramebufferWidth, Frame->FramebufferHeight);
+}
+
+void Application::PublishStats()
+{
+	CPU_SCOPE("PublishStats");
+
+	const std::vector<FShader*> AllShaders = GetShaders();
+
+	// Streamed pages show up over several frames.
+	bRenderBusy = (Frame->bPrewarmShaders && PendingShaders > 0) ||
+		(bVirtualTexturing && VirtualTextures.GetPendingPages() > 0) ||
+		std::any_of(AllShaders.begin(), AllShaders.end(), [](const FShader* Shader) { return Shader->IsReloading(); });
+
+	std::vector<FGpuTimerStats> GpuTimers = GpuProfiler.GetStats();
+
+	std::lock_guard<std::mutex> Lock(StatsMutex);
+	PublishedStats.FirstFrameTime = FirstFrameTime;
+	PublishedStats.ShadersLoadTime = ShadersLoadTime;
+	PublishedStats.ColdShadersLoadTime = ColdShadersLoadTime;
+	PublishedStats.WarmShadersLoadTime = WarmShadersLoadTime;
+	PublishedStats.CachedShaders = CachedShaders;
+	PublishedStats.PendingShaders = PendingShaders;
+	PublishedStats.ShadersNum = int(AllShaders.size());
+	PublishedStats.ShaderReloads = ShaderReloads;
+	PublishedStats.FailedShaderReloads = FailedShaderReloads;
+	PublishedStats.SphereVertices = Sphere.GetSize();
+	PublishedStats.MaterialsNum = Sphere.GetMaterialsNum();
+	PublishedStats.IssuedBinds = FStateCache::Get().GetIssuedCalls();
+	PublishedStats.SkippedBinds = FStateCache::Get().GetSkippedCalls();
+	PublishedStats.bVirtualTexturing = bVirtualTexturing;
+	PublishedStats.VirtualTexturingFailures = VirtualTexturingFailures;
+	PublishedStats.ResidentPages = bVirtualTexturing ? VirtualTextures.GetResidentPages() : 0;
+	PublishedStats.PageCapacity = bVirtualTexturing ? VirtualTextures.GetCapacity() : 0;
+	PublishedStats.PendingPages = bVirtualTexturing ? int(VirtualTextures.GetPendingPages()) : 0;
+	PublishedStats.ResolutionScale = DynamicResolution.GetScale();
+	PublishedStats.SceneWidth = SceneWidth;
+	PublishedStats.SceneHeight = SceneHeight;
+	PublishedStats.GpuTimers = std::move(GpuTimers);
+}
+
+void Application::UpdateShaders()
+{
+	CPU_SCOPE("UpdateShaders");
+
+	if (PendingShaders == 0)
+	{
+		return;
+	}
+
+	const std::vector<FShader*> AllShaders = GetShaders();
+
+	for (FShader* Shader : AllShaders)
+	{
+		if (Shader->IsSubmitted() && !Shader->IsReady() && Shader->Poll())
+		{
+			OnShaderReady(*Shader);
+		}
+	}
+
+	// One more program per frame, finished by the polling above once the driver is done.
+	if (Frame->bPrewarmShaders)
+	{
+		for (FShader* Shader : AllShaders)
+		{
+			if (!Shader->IsSubmitted())
+			{
+				Shader->Submit();
+				if (Shader->IsReady())
+				{
+					OnShaderReady(*Shader);
+				}
+				break;
+			}
+		}
+	}
+}
+
+void Application::ReloadShaders()
+{
+	CPU_SCOPE("ReloadShaders");
+
+	const std::vector<FShader*> AllShaders = GetShaders();
+
+	for (const std::string& File : ShaderWatcher.TakeChanges())
+	{
+		FShader::InvalidateSource(File);
+
+		for (FShader* Shader : AllShaders)
+		{
+			if (Shader->DependsOn(File))
+			{
+				Shader->Reload();
+				RequestRedraw();
+			}
+		}
+	}
+
+	// New program replaces the old one at frame start only once it is linked.
+	for (FShader* Shader : AllShaders)
+	{
+		if (!Shader->IsReloading())
+		{
+			continue;
+		}
+
+		if (Shader->PollReload())
+		{
+			++ShaderReloads;
+			UpdateShaderPermutation(*Shader);
+			RequestRedraw();
+		}
+		else if (!Shader->IsReloading())
+		{
+			++FailedShaderReloads;
+			RequestRedraw();
+		}
+	}
+}
+
+std::vector<FShader*> Application::GetShaders()
 {
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	Window = glfwCreateWindow(ScreenWidth, ScreenHeight, "PBR", NULL, NULL);
-	if (!Window)
+	std::vector<FShader*> AllShaders;
+	for (auto& Shad : Shaders)
 	{
-		std::cout << "Failed to create GLFW Window" << std::endl;
-		glfwTerminate();
+		AllShaders.push_back(&Shad);
 	}
+	AllShaders.push_back(&InstancedShader);
+	AllShaders.push_back(&DepthShader);
+	AllShaders.push_back(&DepthInstancedShader);
+	return AllShaders;
+}
 
-	const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
-	glfwSetWindowMonitor(Window, nullptr, 96, 50, ScreenWidth, ScreenHeight, mode->refreshRate);
+void Application::SubmitDrawShaders()
+{
+	CPU_SCOPE("SubmitDrawShaders");
 
-	glfwMakeContextCurrent(Window);
+	for (const FDrawItem& Item : Frame->Draws)
+	{
+		FShader& Shader = Item.Pass != EDrawPass::EDepthPrepass ? *Item.Shader : Item.bInstanced ? DepthInstancedShader : DepthShader;
+		if (!Shader.IsSubmitted())
+		{
+			Shader.Submit();
+			// Permutation compiled before is ready right away.
+			if (Shader.IsReady())
+			{
+				OnShaderReady(Shader);
+			}
+		}
+	}
+}
 
-	glfwSetFramebufferSizeCallback(Window, &Application::_FramebufferSizeCallback);
-	glfwSetKeyCallback(Window, &Application::_KeyCallback);
-	glfwSetScrollCallback(Window, &Application::_ScrollCallback);
+void Application::MaterializeShader(FShader& Shader)
+{
+	CPU_SCOPE("MaterializeShader");
 
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	// Shader submitted before a setting changed switches permutation once ready and is compiled again.
+	while (!Shader.IsReady())
 	{
-		std::cout << "Failed to initialize GLAD" << std::endl;
+		Shader.Init();
+		OnShaderReady(Shader);
 	}
 }
 
-void Application::Run()
+void Application::OnShaderReady(FShader& Shader)
 {
-	Begin();
-
-	while (!glfwWindowShouldClose(Window))
+	// Later permutation switches do not count towards the startup.
+	if (ShadersLoadTime == 0.f)
 	{
-		Camera.ProcessInput(Window);
-		Draw();
+		CachedShaders += Shader.IsLoadedFromCache() ? 1 : 0;
+	}
+	if (--PendingShaders == 0 && ShadersLoadTime == 0.f)
+	{
+		ShadersLoadTime = float((glfwGetTime() - ShadersStartTime) * 1000.);
+		FShader::RecordLoadTime(CachedShaders == int(GetShaders().size()), ShadersLoadTime, ColdShadersLoadTime, WarmShadersLoadTime);
 	}
 
-	End();
+	UpdateShaderPermutation(Shader);
 }
 
-void Application::Begin()
+void Application::UpdateShaderPermutation(FShader& Shader)
 {
-	{
-		IMGUI_CHECKVERSION();
-		ImGui::CreateContext();
-		ImGui::StyleColorsDark();
-		ImGui_ImplGlfw_InitForOpenGL(Window, true);
-		ImGui_ImplOpenGL3_Init("#version 330");
+	const bool bWasReady = Shader.IsReady();
 
-		glEnable(GL_DEPTH_TEST);
-		glDepthFunc(GL_LESS);
+	// Texture arrays are not virtualized.
+	if (Shader.HasDefine("TEXTURED") && !Shader.HasDefine("TEXTURE_ARRAY"))
+	{
+		Shader.SetDefine("VIRTUAL_TEXTURING", bVirtualTexturing);
 	}
+	SelectDefine(Shader, "FRESNEL_SCHLICK", "FRESNEL_COOK_TORRANCE", bFresnelSchlick);
+	SelectDefine(Shader, "LIGHTS_UNIFORM_BUFFER", "LIGHTS_UNIFORMS", bLightsUniformBuffer);
 
+	// Switched permutation is compiled like the others, by the prewarm or on first use.
+	if (bWasReady && !Shader.IsReady())
 	{
-		Sphere.Init(SphereSegments);
+		++PendingShaders;
+	}
 
-		glm::mat4 Projection = glm::perspective(glm::radians(60.0f), (float)ScreenWidth / ScreenHeight, 0.01f, 10000.0f);
+	if (Shader.IsReady())
+	{
+		Shader.Use();
+		Shader.SetMat4("Projection", Projection);
 
-		for (auto& Shad : Shaders)
+		// GL 3.3 has no binding layout qualifier, the block is bound once per program.
+		const GLuint LightsBlock = Shader.GetID() != 0 && Shader.HasDefine("LIGHTS_UNIFORM_BUFFER") ? glGetUniformBlockIndex(Shader.GetID(), "Lights") : GL_INVALID_INDEX;
+		if (LightsBlock != GL_INVALID_INDEX)
 		{
-			Shad.Init();
-			Shad.SetMat4("Projection", Projection);
+			glUniformBlockBinding(Shader.GetID(), LightsBlock, LIGHTS_UNIFORM_BINDING);
 		}
-
-		ShaderOne = &Shaders.back();
 	}
 }
 
-void Application::End()
-{
-	ImGui_ImplOpenGL3_Shutdown();
-	ImGui_ImplGlfw_Shutdown();
-	ImGui::DestroyContext();
-
-	glfwTerminate();
-}
-
-void Application::Draw()
+void Application::DrawScene()
 {
-	glClearColor(0.f, 0.f, 0.f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	CPU_SCOPE("DrawScene");
 
-	DrawScene();
-	DrawGUI();
+	if (bLightsUniformBuffer)
+	{
+		UploadLights();
+	}
 
-	glfwSwapBuffers(Window);
-	glfwPollEvents();
-}
+	SubmitDrawShaders();
 
-void Application::DrawScene()
-{
-	switch (Scene)
-	{
-	case EScene::EDemo:
+	// Sorting puts the pre-pass first.
+	auto Item = Frame->Draws.begin();
+	if (Frame->bDepthPrepass)
 	{
-		float Offset = 6.25f;
-		int i = 0;
-		for (auto& Shad : Shaders)
+		CPU_SCOPE("DepthPrepass");
+		FGpuScope Scope(GpuProfiler, "Depth Pre-Pass");
+
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		for (; Item != Frame->Draws.end() && Item->Pass == EDrawPass::EDepthPrepass; ++Item)
 		{
-			SetLights(Shad);
-			DrawSphere(Shad, Offset);
-			if (i++ == 2)
-			{
-				Offset -= 2.5f;
-			}
-			Offset -= 2.5f;
+			DrawDepth(*Item);
 		}
-		break;
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+		// Only the nearest fragment of every pixel is shaded.
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
 	}
-	case EScene::EStudy:
+
+	for (; Item != Frame->Draws.end(); ++Item)
 	{
-		if (ShaderOne)
+		MaterializeShader(*Item->Shader);
+		SetLights(*Item->Shader);
+
+		if (Item->bInstanced)
 		{
-			SetLights(*ShaderOne);
-			DrawSphere(*ShaderOne, 0.f);
+			DrawMaterials();
 		}
-		break;
+		else
+		{
+			DrawSphere(*Item->Shader, Item->Offset);
+		}
+	}
+
+	if (Frame->bDepthPrepass)
+	{
+		// Depth writes are needed by the next clear.
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
 	}
+}
+
+void Application::DrawDepth(const FDrawItem& Item)
+{
+	FShader& Shader = Item.bInstanced ? DepthInstancedShader : DepthShader;
+	MaterializeShader(Shader);
+	Shader.Use();
+
+	// Same matrices as the opaque pass, the depth test there is for equality.
+	Shader.SetMat4("Projection", Projection);
+	Shader.SetMat4("View", Frame->View);
+	Shader.SetMat4("Model", Item.bInstanced ? glm::mat4(1.0f) : glm::translate(glm::mat4(1.0f), glm::vec3(Item.Offset, 0.f, 0.f)));
+
+	if (Item.bInstanced)
+	{
+		Sphere.DrawDepthInstanced();
+	}
+	else
+	{
+		Sphere.DrawDepth();
 	}
 }
 
 void Application::DrawSphere(FShader& Shader, float Offset)
 {
+	CPU_SCOPE("DrawSphere");
+	FGpuScope Scope(GpuProfiler, Shader.GetName());
+
 	// Draw Name as text.
 	Shader.Use();
 
-	Shader.SetMat4("View", Camera.GetView());
-	Shader.SetVec3("CameraPos", Camera.GetPosition());
+	// Linear output is encoded to sRGB by the framebuffer instead of pow() in the shader.
+	if (Shader.IsLinearOutput())
+	{
+		glEnable(GL_FRAMEBUFFER_SRGB);
+	}
+	else
+	{
+		glDisable(GL_FRAMEBUFFER_SRGB);
+	}
+
+	Shader.SetMat4("View", Frame->View);
+	Shader.SetVec3("CameraPos", Frame->CameraPosition);
 
-	Shader.SetVec3("Albedo", Albedo);
-	Shader.SetFloat("Metallic", Metallic);
-	Shader.SetFloat("Roughness", Roughness);
+	Shader.SetVec3("Albedo", Frame->Albedo);
+	Shader.SetFloat("Metallic", Frame->Metallic);
+	Shader.SetFloat("Roughness", Frame->Roughness);
 
 	Shader.SetInt("AlbedoMap", 0);
 	Shader.SetInt("NormalMap", 1);
 	Shader.SetInt("MetallicMap", 2);
 	Shader.SetInt("RoughnessMap", 3);
 
+	if (bVirtualTexturing)
+	{
+		VirtualTextures.Bind(Shader);
+	}
+
 	glm::mat4 Model = glm::translate(glm::mat4(1.0f), glm::vec3(Offset, 0.f, 0.f));
 
 	Shader.SetMat4("Model", Model);
 	Sphere.Draw();
 }
 
+void Application::DrawMaterials()
+{
+	CPU_SCOPE("DrawMaterials");
+	FGpuScope Scope(GpuProfiler, InstancedShader.GetName());
+
+	InstancedShader.Use();
+
+	glEnable(GL_FRAMEBUFFER_SRGB);
+
+	InstancedShader.SetMat4("View", Frame->View);
+	InstancedShader.SetVec3("CameraPos", Frame->CameraPosition);
+
+	InstancedShader.SetInt("AlbedoMap", 0);
+	InstancedShader.SetInt("NormalMap", 1);
+	InstancedShader.SetInt("MetallicMap", 2);
+	InstancedShader.SetInt("RoughnessMap", 3);
+
+	InstancedShader.SetMat4("Model", glm::mat4(1.0f));
+	Sphere.DrawInstanced();
+}
+
+float Application::GetSphereOffset(size_t Index) const
+{
+	// Spheres 2.5 apart, with a gap between untextured and textured ones.
+	return 6.25f - 2.5f * Index - (Index > 2 ? 2.5f : 0.f);
+}
+
+void Application::DrawVirtualTextureFeedback()
+{
+	CPU_SCOPE("DrawVirtualTextureFeedback");
+
+	FShader* Shader = VirtualTextures.BeginFeedback(Frame->FramebufferWidth, Frame->FramebufferHeight);
+	if (!Shader)
+	{
+		return;
+	}
+
+	Shader->SetMat4("View", Frame->View);
+
+	// Instanced materials sample texture arrays, which are not virtualized. Depth pre-pass items repeat the scene ones.
+	for (const FDrawItem& Item : Frame->Draws)
+	{
+		if (Item.Pass == EDrawPass::EDepthPrepass || Item.bInstanced || !Item.Shader->HasDefine("TEXTURED") || !Item.Shader->IsReady())
+		{
+			continue;
+		}
+
+		Shader->SetMat4("Model", glm::translate(glm::mat4(1.0f), glm::vec3(Item.Offset, 0.f, 0.f)));
+		Sphere.Draw();
+	}
+
+	VirtualTextures.EndFeedback();
+}
+
 void Application::DrawGUI()
 {
-	ImGui_ImplOpenGL3_NewFrame();
+	CPU_SCOPE("DrawGUI");
+
 	ImGui_ImplGlfw_NewFrame();
 	ImGui::NewFrame();
 
@@ -202,33 +1309,155 @@ void Application::DrawGUI()
 		ImGui::InputInt("Sphere Segments", &SphereSegments, 32, 32);
 		if (ImGui::Button("Set Sphere Segments"))
 		{
-			Sphere.Init(SphereSegments);
+			AppliedSphereSegments = SphereSegments;
+		}
+
+		ImGui::NewLine();
+
+		{
+			const std::string PathFile = Options.CameraPath.empty() ? CAMERA_PATH_FILE : Options.CameraPath;
+
+			ImGui::Text("Camera Path : %d keys, %.1f s", int(CameraPath.GetKeysNum()), CameraPath.GetDuration());
+			if (ImGui::Button(CameraPath.IsRecording() ? "Stop Recording" : "Record"))
+			{
+				if (CameraPath.IsRecording())
+				{
+					CameraPath.StopRecording();
+				}
+				else
+				{
+					CameraPath.StartRecording(glfwGetTime());
+				}
+			}
+			ImGui::SameLine();
+			if (ImGui::Button(CameraPath.IsPlaying() ? "Stop" : "Play"))
+			{
+				if (CameraPath.IsPlaying())
+				{
+					CameraPath.StopPlayback();
+				}
+				else
+				{
+					CameraPath.StartPlayback();
+				}
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Save"))
+			{
+				CameraPathStatus = CameraPath.Save(PathFile) ? "Saved " + PathFile : "Failed to save " + PathFile;
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Load"))
+			{
+				CameraPathStatus = CameraPath.Load(PathFile) ? "Loaded " + PathFile : "Failed to load " + PathFile;
+			}
+			if (CameraPath.IsPlaying())
+			{
+				ImGui::Text("Playing : %.2f / %.2f s", CameraPath.GetPlaybackTime(), CameraPath.GetDuration());
+			}
+			else if (!CameraPathStatus.empty())
+			{
+				ImGui::Text("%s", CameraPathStatus.c_str());
+			}
+		}
+
+		ImGui::NewLine();
+
+		ImGui::Checkbox("Prewarm Shaders", &bPrewarmShaders);
+		ImGui::Checkbox("Render On Demand", &bRenderOnDemand);
+		ImGui::Checkbox("Depth Pre-Pass In This Scene", &DepthPrepass[int(Scene)]);
+		ImGui::Checkbox("Dynamic Resolution", &bDynamicResolution);
+		if (bDynamicResolution)
+		{
+			ImGui::SliderFloat("Target GPU Frame Time (ms)", &TargetFrameTime, 2.f, 50.f);
 		}
 
+		// Initialized by the render thread, unchecked again if that fails.
+		ImGui::Checkbox("Virtual Texturing", &bEnableVirtualTexturing);
+		// Compiled in, switching recompiles the shaders.
+		ImGui::Checkbox("Schlick Fresnel", &bUseFresnelSchlick);
+		ImGui::Checkbox("Lights In Uniform Buffer", &bUseLightsUniformBuffer);
+
 		ImGui::End();
 	}
 
 	{
 		ImGui::Begin("Information and Statistics");
 
-		ImGui::Text(
-			Scene == EScene::EStudy
-			? "Research Scene"
-			: "Demo Scene"
-		);
-		ImGui::Text("Shaders Showed :");
-		ImGui::Text(
-			Scene == EScene::EStudy
-			? ShaderOne->GetName().c_str()
-			: ("From left : 1." + Shaders[0].GetName() + " 2. " + Shaders[1].GetName() + " 3. " + Shaders[2].GetName() + " 4. " +
-				Shaders[3].GetName() + " 5. " + Shaders[4].GetName() + " 6. " + Shaders[5].GetName()).c_str()
-		);
+		switch (Scene)
+		{
+		case EScene::EDemo:
+			ImGui::Text("Demo Scene");
+			ImGui::Text("Shaders Showed :");
+			ImGui::Text(("From left : 1." + Shaders[0].GetName() + " 2. " + Shaders[1].GetName() + " 3. " + Shaders[2].GetName() + " 4. " +
+				Shaders[3].GetName() + " 5. " + Shaders[4].GetName() + " 6. " + Shaders[5].GetName()).c_str());
+			break;
+		case EScene::EStudy:
+			ImGui::Text("Research Scene");
+			ImGui::Text("Shaders Showed :");
+			ImGui::Text(ShaderOne->GetName().c_str());
+			break;
+		case EScene::EMaterials:
+			ImGui::Text("Materials Scene");
+			ImGui::Text("Shaders Showed :");
+			ImGui::Text("%s, %d materials, 1 draw call", InstancedShader.GetName().c_str(), Stats.MaterialsNum);
+			break;
+		}
 
 		ImGui::NewLine();
 
 		ImGui::Text("FPS : %.2f", ImGui::GetIO().Framerate);
+		ImGui::Text("First Frame : %.1f ms", Stats.FirstFrameTime);
+		if (Stats.PendingShaders > 0)
+		{
+			ImGui::Text("Shaders Not Compiled Yet : %d", Stats.PendingShaders);
+		}
+		else
+		{
+			ImGui::Text("Shaders Loaded : %.1f ms, %s start (%d of %d from binary cache)", Stats.ShadersLoadTime,
+				Stats.CachedShaders == Stats.ShadersNum ? "warm" : "cold", Stats.CachedShaders, Stats.ShadersNum);
+			// Zero until a start of that kind was recorded.
+			if (Stats.ColdShadersLoadTime > 0.f && Stats.WarmShadersLoadTime > 0.f)
+			{
+				ImGui::Text("Last Cold Start : %.1f ms, Last Warm Start : %.1f ms (%.1fx faster)", Stats.ColdShadersLoadTime,
+					Stats.WarmShadersLoadTime, Stats.ColdShadersLoadTime / Stats.WarmShadersLoadTime);
+			}
+			else
+			{
+				ImGui::Text("Start again to compare cold and warm start");
+			}
+		}
+		if (bRenderOnDemand)
+		{
+			ImGui::Text("Frames Skipped : %d", FramesSkipped);
+		}
+		if (Stats.ShaderReloads > 0 || Stats.FailedShaderReloads > 0)
+		{
+			ImGui::Text("Shader Reloads : %d (%d failed)", Stats.ShaderReloads, Stats.FailedShaderReloads);
+		}
+		if (bDynamicResolution)
+		{
+			ImGui::Text("Scene Resolution : %dx%d (%.0f%%)", Stats.SceneWidth, Stats.SceneHeight, Stats.ResolutionScale * 100.f);
+		}
 		ImGui::Text("Lights Number : %d", LightsColumns * LightsRows);
-		ImGui::Text("Vertices : %d", Sphere.GetSize() * (Scene == EScene::EStudy ? 1 : 6));
+		ImGui::Text("GL Binds : %d issued, %d skipped", Stats.IssuedBinds, Stats.SkippedBinds);
+		ImGui::Text("Vertices : %zu", Stats.SphereVertices *
+			(Scene == EScene::EStudy ? 1 : Scene == EScene::EMaterials ? MATERIAL_COLUMNS * MATERIAL_ROWS : DEMO_SPHERES));
+		if (Stats.bVirtualTexturing)
+		{
+			ImGui::Text("Virtual Texture Pages : %d / %d (%d pending)", Stats.ResidentPages, Stats.PageCapacity, Stats.PendingPages);
+		}
+
+		if (ImGui::CollapsingHeader("GPU Timings", ImGuiTreeNodeFlags_DefaultOpen))
+		{
+			DrawGpuTimings();
+		}
+#if CPU_PROFILER
+		if (ImGui::CollapsingHeader("CPU Timings", ImGuiTreeNodeFlags_DefaultOpen))
+		{
+			DrawCpuTimings();
+		}
+#endif
 
 		ImGui::End();
 	}
@@ -244,6 +1473,7 @@ void Application::DrawGUI()
 		ImGui::Text("	Change Shader to Gouraud with texture = \"4\"");
 		ImGui::Text("	Change Shader to BlinnPhong with texture = \"5\"");
 		ImGui::Text("	Change Shader to PBR with texture = \"6\"");
+		ImGui::Text("	Change Shader to PBR with texture and vertex tangents = \"7\"");
 		ImGui::Text("	Move Forward = \"w\"");
 		ImGui::Text("	Move Back = \"s\"");
 		ImGui::Text("	Move Left = \"a\"");
@@ -258,45 +1488,160 @@ void Application::DrawGUI()
 		ImGui::End();
 	}
 
+	if (DebugOutput.IsInitialized())
+	{
+		ImGui::Begin("Performance Warnings");
+
+		const std::vector<int> SourceCounts = DebugOutput.GetSourceCounts();
+		for (size_t i = 0; i < SourceCounts.size(); ++i)
+		{
+			ImGui::Text("%s : %d", FDebugOutput::GetSourceName(i), SourceCounts[i]);
+		}
+
+		bool bLogging = DebugOutput.IsLogging();
+		if (ImGui::Checkbox("Log To File", &bLogging))
+		{
+			DebugOutput.SetLogFile(bLogging ? "gl_debug.log" : "");
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Clear"))
+		{
+			DebugOutput.Clear();
+		}
+
+		ImGui::Separator();
+
+		for (const FDebugMessage& Message : DebugOutput.GetMessages())
+		{
+			ImGui::TextWrapped("%dx [%s %u] %s", Message.Count, Message.SourceName, Message.Id, Message.Text.c_str());
+		}
+
+		ImGui::End();
+	}
+
 	ImGui::Render();
-	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+}
+
+void Application::DrawGpuTimings()
+{
+	const std::vector<FGpuTimerStats>& Timers = Stats.GpuTimers;
+
+	ImGui::Text("Averaged over %d frames, read back %d frames late.", GPU_PROFILER_HISTORY, GPU_PROFILER_LATENCY);
+	for (const FGpuTimerStats& Timer : Timers)
+	{
+		ImGui::Text("%s : %.3f ms (avg %.3f, p95 %.3f)", Timer.Name.c_str(), Timer.Last, Timer.Average, Timer.P95);
+	}
+
+	// Average time of every shader drawn recently, same sphere and lights for all.
+	std::vector<float> ShaderTimes;
+	std::string ShaderNames;
+	for (FShader* Shader : GetShaders())
+	{
+		auto Found = std::find_if(Timers.begin(), Timers.end(), [Shader](const FGpuTimerStats& Timer) { return Timer.Name == Shader->GetName(); });
+		if (Found != Timers.end())
+		{
+			ShaderNames += std::to_string(ShaderTimes.size() + 1) + ". " + Shader->GetName() + "\n";
+			ShaderTimes.push_back(Found->Average);
+		}
+	}
+
+	if (!ShaderTimes.empty())
+	{
+		ImGui::PlotHistogram("##ShaderTimes", ShaderTimes.data(), int(ShaderTimes.size()), 0, "Average ms per shader",
+			0.f, FLT_MAX, ImVec2(0.f, 80.f));
+		ImGui::TextUnformatted(ShaderNames.c_str());
+	}
+}
+
+void Application::DrawCpuTimings()
+{
+	FCpuProfiler& Profiler = FCpuProfiler::Get();
+
+	ImGui::Text("Frame : %.2f ms", Profiler.GetFrameTime());
+	if (Profiler.GetDroppedEvents() > 0)
+	{
+		ImGui::Text("Dropped Events : %d", Profiler.GetDroppedEvents());
+	}
+
+	if (Profiler.IsCapturing())
+	{
+		ImGui::Text("%s", Profiler.GetCaptureStatus().c_str());
+	}
+	else
+	{
+		if (ImGui::Button("Capture 120 Frames"))
+		{
+			Profiler.StartCapture(120, CPU_TRACE_FILE);
+		}
+		ImGui::SameLine();
+		ImGui::Text("%s", Profiler.GetCaptureStatus().c_str());
+	}
+
+	DrawCpuSummary(Profiler.GetSummary(), -1, Profiler.GetFrameTime());
 }
 
 void Application::SetLights(FShader& Shader)
 {
+	CPU_SCOPE("SetLights");
+	FGpuScope Scope(GpuProfiler, "Lights Upload");
+
 	Shader.Use();
 
-	Shader.SetInt("LightsNum", LightsRows * LightsColumns);
+	Shader.SetInt("LightsNum", int(Frame->LightPositions.size()));
 
-	std::vector<glm::vec3> LightPositions;
+	// Positions were uploaded once for all the programs by UploadLights.
+	if (Shader.HasDefine("LIGHTS_UNIFORM_BUFFER"))
+	{
+		return;
+	}
 
-	unsigned int Index = 0;
-	for (int j = 0; j < LightsRows; ++j)
+	for (size_t Index = 0; Index < Frame->LightPositions.size(); ++Index)
 	{
-		for (int i = 0; i < LightsColumns; ++i)
-		{
-			LightPositions.emplace_back(
-				LightsOffset + 
-				glm::vec3(
-					(LightsColumns - 1) * IntervalBetweenLights / 2.f - IntervalBetweenLights * i,
-					(LightsRows - 1) * IntervalBetweenLights / 2.f - IntervalBetweenLights * j,
-					0.f));
+		Shader.SetVec3("LightPositions[" + std::to_string(Index) + "]", Frame->LightPositions[Index]);
+	}
+}
 
-			Shader.SetVec3("LightPositions[" + std::to_string(Index) + "]", LightPositions[Index]);
-			++Index;
-		}
+void Application::UploadLights()
+{
+	CPU_SCOPE("UploadLights");
+	FGpuScope Scope(GpuProfiler, "Lights Upload");
+
+	if (!LightsUBO)
+	{
+		glGenBuffers(1, &LightsUBO);
 	}
+
+	// std140 array stride is a vec4.
+	std::vector<glm::vec4> Positions;
+	Positions.reserve(Frame->LightPositions.size());
+	for (const glm::vec3& Position : Frame->LightPositions)
+	{
+		Positions.emplace_back(Position, 1.f);
+	}
+	Positions.resize(std::min(Positions.size(), size_t(MAX_LIGHTS)));
+
+	// Whole block is allocated, so the binding is valid with no lights too. New storage every frame
+	// lets the driver keep the previous one for frames still in flight.
+	FStateCache::Get().BindBuffer(GL_UNIFORM_BUFFER, LightsUBO);
+	glBufferData(GL_UNIFORM_BUFFER, MAX_LIGHTS * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, Positions.size() * sizeof(glm::vec4), Positions.data());
+	glBindBufferBase(GL_UNIFORM_BUFFER, LIGHTS_UNIFORM_BINDING, LightsUBO);
 }
 
 void Application::KeyCallback(GLFWwindow* inWindow, int Key, int ScanCode, int Action, int Mods)
 {
+	RequestRedraw();
+
 	if (glfwGetKey(inWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 	{
 		glfwSetWindowShouldClose(inWindow, true);
 	}
 	if (glfwGetKey(inWindow, GLFW_KEY_GRAVE_ACCENT) == GLFW_PRESS)
 	{
-		Scene = Scene == EScene::EDemo ? EScene::EStudy : EScene::EDemo;
+		Scene =
+			Scene == EScene::EDemo ? EScene::EStudy :
+			Scene == EScene::EStudy ? EScene::EMaterials :
+			EScene::EDemo;
 	}
 	if (glfwGetKey(inWindow, GLFW_KEY_1) == GLFW_PRESS)
 	{
@@ -322,16 +1667,39 @@ void Application::KeyCallback(GLFWwindow* inWindow, int Key, int ScanCode, int A
 	{
 		ShaderOne = &Shaders[5];
 	}
+	if (glfwGetKey(inWindow, GLFW_KEY_7) == GLFW_PRESS)
+	{
+		ShaderOne = &Shaders[6];
+	}
 }
 
 void Application::FramebufferSizeCallback(GLFWwindow* inWindow, int Width, int Height)
 {
-	glViewport(0, 0, Width, Height);
+	// Viewport is set by the render thread from the size in the frame packet.
+	RequestRedraw();
 }
 
 void Application::ScrollCallback(GLFWwindow* inWindow, double xoffset, double yoffset)
 {
 	Camera.AddSpeed((float)yoffset/100.f);
+	RequestRedraw();
+}
+
+void Application::CursorPosCallback(GLFWwindow* inWindow, double xpos, double ypos)
+{
+	// GUI hover and drags.
+	RequestRedraw();
+}
+
+void Application::MouseButtonCallback(GLFWwindow* inWindow, int Button, int Action, int Mods)
+{
+	RequestRedraw();
+}
+
+void Application::WindowRefreshCallback(GLFWwindow* inWindow)
+{
+	// Window was uncovered or restored.
+	RequestRedraw();
 }
 
 // STATIC FUNCTION CALLBACKS 
@@ -350,3 +1718,18 @@ void Application::_ScrollCallback(GLFWwindow* inWindow, double xoffset, double y
 {
 	Instance->ScrollCallback(inWindow, xoffset, yoffset);
 }
+
+void Application::_CursorPosCallback(GLFWwindow* inWindow, double xpos, double ypos)
+{
+	Instance->CursorPosCallback(inWindow, xpos, ypos);
+}
+
+void Application::_MouseButtonCallback(GLFWwindow* inWindow, int Button, int Action, int Mods)
+{
+	Instance->MouseButtonCallback(inWindow, Button, Action, Mods);
+}
+
+void Application::_WindowRefreshCallback(GLFWwindow* inWindow)
+{
+	Instance->WindowRefreshCallback(inWindow);
+}
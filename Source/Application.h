@@ -4,52 +4,305 @@ struct GLFWwindow;
 
 #include "Primitives/Sphere.h"
 #include "Shaders/Shader.h"
+#include "Shaders/ShaderWatcher.h"
 #include "Camera/Camera.h"
+#include "Camera/CameraPath.h"
+#include "Texture/RenderTarget.h"
+#include "Texture/VirtualTexture.h"
+#include "Profiling/DebugOutput.h"
+#include "Profiling/CpuProfiler.h"
+#include "Profiling/GpuProfiler.h"
+#include "Render/DynamicResolution.h"
+#include "Render/FramePacket.h"
+#include "Render/StateCache.h"
 #include "vector"
 
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// Shaders of study scene, selected by the number keys and --shader.
+#define STUDY_SHADERS 7
+
 enum class EScene
 {
 	EDemo,
 	EStudy,
+	// Grid of textured spheres with different materials drawn in one instanced draw call.
+	EMaterials,
+};
+
+// Context creation API requested from GLFW.
+enum class EContextApi
+{
+	ENative,
+	// Surfaceless EGL and OSMesa work without a display, GLFW has to be built with the matching backend.
+	EEGL,
+	EOSMesa,
+};
+
+enum class EGoldenMode
+{
+	ENone,
+	// Stores canonical views of every shader as golden images.
+	ECapture,
+	// Renders the same views and compares them against the stored golden images.
+	ECompare,
+};
+
+// Command line options.
+struct FApplicationOptions
+{
+	// Creates debug context and shows driver performance warnings.
+	bool bDebugContext = false;
+
+	// Renders fixed number of frames offscreen in a hidden window, writes per frame times to BenchmarkOutput and exits.
+	bool bBenchmark = false;
+	EContextApi ContextApi = EContextApi::ENative;
+	int BenchmarkWidth = 1920;
+	int BenchmarkHeight = 1080;
+	int WarmupFrames = 60;
+	int BenchmarkFrames = 300;
+	std::string BenchmarkOutput = "benchmark.csv";
+
+	// Scene settings, negative values keep the defaults.
+	EScene Scene = EScene::EDemo;
+	// Index of the shader shown in study scene, same as the number keys minus one.
+	int Shader = -1;
+	int LightsColumns = -1;
+	int LightsRows = -1;
+	int SphereSegments = -1;
+	// Depth pre-pass in the scene above.
+	bool bDepthPrepass = false;
+
+	// Scales scene resolution to keep GPU frame time at TargetFrameTime milliseconds,
+	// passes drawn at window resolution are subtracted from the scene budget.
+	bool bDynamicResolution = false;
+	float TargetFrameTime = 16.7f;
+
+	// Redraws only after input or when something is still loading.
+	bool bRenderOnDemand = false;
+	// Builds and renders frames on the main thread instead of handing them to the render thread.
+	bool bSingleThreaded = false;
+
+	// Camera path replayed by benchmark, also the file recorded paths are saved to.
+	std::string CameraPath;
+
+	EGoldenMode GoldenMode = EGoldenMode::ENone;
+	std::string GoldenDirectory;
+
+	// Renders offscreen without GUI and exits.
+	bool IsHeadless() const { return bBenchmark || GoldenMode != EGoldenMode::ENone; };
+};
+
+// Render thread state shown in the GUI, published after every rendered frame.
+struct FRenderStats
+{
+	float FirstFrameTime = 0.f;
+	float ShadersLoadTime = 0.f;
+	// Last cold and warm start, this one or previous runs.
+	float ColdShadersLoadTime = 0.f;
+	float WarmShadersLoadTime = 0.f;
+	int CachedShaders = 0;
+	int PendingShaders = 0;
+	int ShadersNum = 0;
+	int ShaderReloads = 0;
+	int FailedShaderReloads = 0;
+
+	size_t SphereVertices = 0;
+	int MaterialsNum = 0;
+
+	// Bind calls of the last frame issued to the driver and skipped by the state cache.
+	int IssuedBinds = 0;
+	int SkippedBinds = 0;
+
+	bool bVirtualTexturing = false;
+	// Failed attempts to enable virtual texturing, the GUI clears its checkbox on a new one.
+	int VirtualTexturingFailures = 0;
+	int ResidentPages = 0;
+	int PageCapacity = 0;
+	int PendingPages = 0;
+
+	float ResolutionScale = 1.f;
+	int SceneWidth = 0;
+	int SceneHeight = 0;
+
+	std::vector<FGpuTimerStats> GpuTimers;
 };
 
 class Application
 {
 public:
 
-	Application();
+	Application(const FApplicationOptions& inOptions = FApplicationOptions());
 
-	void Run();
+	// Returns process exit code.
+	int Run();
 
 private:
 
 	void Init();
+	// Draws the frames into offscreen target and writes the CSV, returns exit code.
+	int RunBenchmark();
+	// Captures or compares golden images of every shader, returns exit code.
+	int RunGoldenImages();
 	void Begin();
 	void End();
 
-	void Draw();
+	// Live input, recording or fixed step playback of the camera path.
+	void UpdateCamera();
+	// Render on demand draws the next few frames, so the GUI settles after input.
+	void RequestRedraw();
+	// Input, edits or loads in progress since the last drawn frame.
+	bool IsRedrawNeeded() const;
+
+	// Main thread : snapshot of camera, lights, draw list and GUI for the render thread.
+	std::unique_ptr<FFramePacket> BuildFrame();
+	// Render thread : consumes frame packets until the queue is stopped.
+	void RenderLoop();
+	// Render thread : draws the packet and presents it.
+	void Draw(FFramePacket& inFrame);
+	// Render thread : rebuilds GL objects whose settings changed in the packet.
+	void ApplyFrameSettings();
+	// Render thread : binds the scene target at the scale chosen from the measured scene time,
+	// returns false if the scene is drawn to the window at native resolution.
+	bool BeginDynamicResolution();
+	// Render thread : upscales the scene to the window.
+	void EndDynamicResolution();
+	void PublishStats();
+	// Finishes shaders whose compilation is done and submits the next one to prewarm.
+	void UpdateShaders();
+	// Submits every program the draws of this frame use and are not compiled yet, so the driver
+	// compiles them in parallel before MaterializeShader waits for the first one.
+	void SubmitDrawShaders();
+	// Finishes shader drawn this frame right away if it is not ready yet.
+	void MaterializeShader(FShader& Shader);
+	void OnShaderReady(FShader& Shader);
+	// Recompiles shaders whose files changed on disk.
+	void ReloadShaders();
+	// Shaders, InstancedShader and the depth pre-pass shaders, everything compiled through MaterializeShader and the prewarm.
+	std::vector<FShader*> GetShaders();
+	// Selects permutation matching current settings, e.g. virtual texturing, and sets its constant uniforms.
+	void UpdateShaderPermutation(FShader& Shader);
+
 	void DrawScene();
 	void DrawGUI();
 
 	void DrawSphere(FShader& Shader,float Offset);
+	void DrawMaterials();
+	void DrawDepth(const FDrawItem& Item);
 	void SetLights(FShader& Shader);
+	// Uploads light positions to the uniform buffer shared by the programs, once per frame.
+	void UploadLights();
+
+	// Per scope GPU times and per shader comparison chart.
+	void DrawGpuTimings();
+	// Averaged CPU call tree and Chrome trace capture.
+	void DrawCpuTimings();
+
+	// Position of the sphere drawn with Shaders[Index] in demo scene.
+	float GetSphereOffset(size_t Index) const;
+
+	// Renders textured spheres with the feedback shader to find virtual texture pages in use.
+	void DrawVirtualTextureFeedback();
 
 	void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 	void FramebufferSizeCallback(GLFWwindow* Window, int Width, int Height);
 	void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
+	void CursorPosCallback(GLFWwindow* window, double xpos, double ypos);
+	void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+	void WindowRefreshCallback(GLFWwindow* window);
 
 private:
 
+	FApplicationOptions Options;
+
+	std::thread RenderThread;
+	FFrameQueue FrameQueue;
+	// Frame being drawn, valid during Draw only.
+	const FFramePacket* Frame = nullptr;
+
+	// Written by the render thread, copied by the main thread for the GUI.
+	std::mutex StatsMutex;
+	FRenderStats PublishedStats;
+	// Main thread copy.
+	FRenderStats Stats;
+	// Render thread has loads in progress which need further frames.
+	std::atomic<bool> bRenderBusy{ false };
+
 	std::vector<FShader> Shaders;
 	FShader* ShaderOne = nullptr;
 
+	// Textured PBR sampling material texture arrays, used in materials scene.
+	FShader InstancedShader;
+
+	// Position only shaders of the depth pre-pass, single sphere and instanced grid.
+	FShader DepthShader;
+	FShader DepthInstancedShader;
+	// Per scene, the pre-pass pays off only when shading costs more than drawing the geometry twice.
+	std::array<bool, 3> DepthPrepass = { { false, false, false } };
+
+	// Startup time of all the shaders, warm start loads every program from the binary cache.
+	double ShadersStartTime = 0.;
+	float ShadersLoadTime = 0.f;
+	float ColdShadersLoadTime = 0.f;
+	float WarmShadersLoadTime = 0.f;
+	float FirstFrameTime = 0.f;
+	int CachedShaders = 0;
+	int PendingShaders = 0;
+	// Shaders not drawn yet are compiled during the following frames instead of on first use.
+	bool bPrewarmShaders = true;
+
+	FShaderWatcher ShaderWatcher;
+
+	FDebugOutput DebugOutput;
+	FGpuProfiler GpuProfiler;
+	int ShaderReloads = 0;
+	int FailedShaderReloads = 0;
+
 	FCamera Camera;
+	FCameraPath CameraPath;
+	// Result of the last save or load from the GUI.
+	std::string CameraPathStatus;
 
 	int ScreenWidth = int(1920. * 0.9);
 	int ScreenHeight = int(1080. * 0.9);
 
 	FSphere Sphere;
 
+	glm::mat4 Projection = glm::mat4(1.f);
+
+	// Render thread state of dynamic resolution, the scene target has the size of the window.
+	FDynamicResolution DynamicResolution;
+	FRenderTarget SceneTarget;
+	int SceneWidth = 0;
+	int SceneHeight = 0;
+	// Window size the scene target could not be created at.
+	int FailedSceneWidth = 0;
+	int FailedSceneHeight = 0;
+	// Main thread settings.
+	bool bDynamicResolution = false;
+	float TargetFrameTime = 16.7f;
+
+	FVirtualTextureSystem VirtualTextures;
+	// Render thread state, enabled once the system is initialized.
+	bool bVirtualTexturing = false;
+	// Value of the packet seen last, initialization is attempted once per request.
+	bool bVirtualTexturingRequested = false;
+	int VirtualTexturingFailures = 0;
+	// Main thread checkbox.
+	bool bEnableVirtualTexturing = false;
+	int SeenVirtualTexturingFailures = 0;
+
+	// Render thread state of the feature defines, matching the defines the shaders are constructed with.
+	bool bFresnelSchlick = false;
+	bool bLightsUniformBuffer = true;
+	GLuint LightsUBO = 0;
+	// Main thread checkboxes.
+	bool bUseFresnelSchlick = false;
+	bool bUseLightsUniformBuffer = true;
+
 	float IntervalBetweenLights = 20.f;
 	glm::vec3 LightsOffset = glm::vec3(5.f, 10.f, -10.f);
 	int LightsColumns = 1;
@@ -59,17 +312,29 @@ private:
 	float Roughness = 0.05f;
 	glm::vec3 Albedo = glm::vec3(0.5f, 0.f, 0.f);
 
+	// Edited in the GUI, applied by the button and built by the render thread.
 	int SphereSegments = 1024;
+	int AppliedSphereSegments = 1024;
+	int BuiltSphereSegments = 0;
 
 	EScene Scene = EScene::EDemo;
 
 	GLFWwindow* Window = nullptr;
+	bool bInitialized = false;
+
+	bool bRenderOnDemand = false;
+	// Frames left to draw after the last redraw request, requested from both threads.
+	std::atomic<int> RedrawFrames{ 0 };
+	int FramesSkipped = 0;
 
 private:
 
 	static void _FramebufferSizeCallback(GLFWwindow* inWindow, int Width, int Height);
 	static void _KeyCallback(GLFWwindow* inWindow, int key, int scancode, int action, int mods);
 	static void _ScrollCallback(GLFWwindow* inWindow, double xoffset, double yoffset);
+	static void _CursorPosCallback(GLFWwindow* inWindow, double xpos, double ypos);
+	static void _MouseButtonCallback(GLFWwindow* inWindow, int button, int action, int mods);
+	static void _WindowRefreshCallback(GLFWwindow* inWindow);
 
 	static Application* Instance;
 };
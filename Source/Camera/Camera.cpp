@@ -34,6 +34,20 @@ void FCamera::CalculateView(double NewX, double NewY)
 	Yaw += Xoffset;
 	Pitch += Yoffset;
 
+	UpdateView();
+}
+
+void FCamera::SetPose(glm::vec3 inPosition, double inYaw, double inPitch)
+{
+	Position = inPosition;
+	Yaw = inYaw;
+	Pitch = inPitch;
+
+	UpdateView();
+}
+
+void FCamera::UpdateView()
+{
 	glm::vec3 Direction = glm::vec3(
 		cos(glm::radians(Yaw)) * cos(glm::radians(Pitch)),
 		sin(glm::radians(Pitch)),
@@ -20,11 +20,20 @@ public:
 
 	void AddSpeed(float Val);
 
+	// Places camera directly, used by camera path playback.
+	void SetPose(glm::vec3 inPosition, double inYaw, double inPitch);
+
 	glm::mat4& GetView();
 	glm::vec3& GetPosition();
+	const glm::vec3& GetPosition() const { return Position; };
+	double GetYaw() const { return Yaw; };
+	double GetPitch() const { return Pitch; };
 
 private:
 
+	// Updates front direction and view from Position, Yaw and Pitch.
+	void UpdateView();
+
 	glm::mat4 View = glm::mat4(0.f);
 
 	glm::vec3 Position = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -0,0 +1,161 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#define CAMERA_PATH_HEADER "PBRCameraPath 1"
+
+namespace
+{
+	template<typename T>
+	T CatmullRom(const T& P0, const T& P1, const T& P2, const T& P3, double t)
+	{
+		const double t2 = t * t;
+		const double t3 = t2 * t;
+		return 0.5 * ((2. * P1) + (P2 - P0) * t + (2. * P0 - 5. * P1 + 4. * P2 - P3) * t2 + (3. * P1 - P0 - 3. * P2 + P3) * t3);
+	}
+}
+
+void FCameraPath::StartRecording(double Time)
+{
+	StopPlayback();
+
+	Keys.clear();
+	RecordingStart = Time;
+	bRecording = true;
+}
+
+void FCameraPath::StopRecording()
+{
+	bRecording = false;
+}
+
+void FCameraPath::Record(double Time, const FCamera& Camera)
+{
+	if (!bRecording)
+	{
+		return;
+	}
+
+	const double KeyTime = Time - RecordingStart;
+	if (!Keys.empty() && KeyTime - Keys.back().Time < CAMERA_PATH_SAMPLE_INTERVAL)
+	{
+		return;
+	}
+
+	FCameraKey Key;
+	Key.Time = KeyTime;
+	Key.Position = Camera.GetPosition();
+	Key.Yaw = Camera.GetYaw();
+	Key.Pitch = Camera.GetPitch();
+	Keys.push_back(Key);
+}
+
+bool FCameraPath::StartPlayback()
+{
+	StopRecording();
+
+	bPlaying = !Keys.empty();
+	PlaybackTime = 0.;
+	return bPlaying;
+}
+
+void FCameraPath::StopPlayback()
+{
+	bPlaying = false;
+}
+
+void FCameraPath::Step(FCamera& Camera)
+{
+	if (!bPlaying)
+	{
+		return;
+	}
+
+	Evaluate(PlaybackTime, Camera);
+
+	if (PlaybackTime >= GetDuration())
+	{
+		bPlaying = false;
+	}
+	PlaybackTime += CAMERA_PATH_TIMESTEP;
+}
+
+void FCameraPath::Evaluate(double Time, FCamera& Camera) const
+{
+	if (Keys.empty())
+	{
+		return;
+	}
+
+	Time = std::max(0., std::min(Time, GetDuration()));
+
+	// First key after Time, segment is between Next - 1 and Next.
+	const auto Found = std::upper_bound(Keys.begin(), Keys.end(), Time, [](double Value, const FCameraKey& Key) { return Value < Key.Time; });
+	const size_t Next = std::min(size_t(Found - Keys.begin()), Keys.size() - 1);
+	const size_t Previous = Next > 0 ? Next - 1 : 0;
+
+	const FCameraKey& K0 = Keys[Previous > 0 ? Previous - 1 : 0];
+	const FCameraKey& K1 = Keys[Previous];
+	const FCameraKey& K2 = Keys[Next];
+	const FCameraKey& K3 = Keys[std::min(Next + 1, Keys.size() - 1)];
+
+	const double Length = K2.Time - K1.Time;
+	const double t = Length > 0. ? (Time - K1.Time) / Length : 0.;
+
+	const glm::dvec3 Position = CatmullRom(glm::dvec3(K0.Position), glm::dvec3(K1.Position), glm::dvec3(K2.Position), glm::dvec3(K3.Position), t);
+	// Yaw is not wrapped by the camera, so it interpolates without jumps.
+	const double Yaw = CatmullRom(K0.Yaw, K1.Yaw, K2.Yaw, K3.Yaw, t);
+	const double Pitch = CatmullRom(K0.Pitch, K1.Pitch, K2.Pitch, K3.Pitch, t);
+
+	Camera.SetPose(glm::vec3(Position), Yaw, Pitch);
+}
+
+bool FCameraPath::Save(const std::string& FileName) const
+{
+	std::ofstream File(FileName);
+	if (!File)
+	{
+		return false;
+	}
+
+	File << CAMERA_PATH_HEADER << "\n" << std::setprecision(9);
+	for (const FCameraKey& Key : Keys)
+	{
+		File << Key.Time << " " << Key.Position.x << " " << Key.Position.y << " " << Key.Position.z << " " << Key.Yaw << " " << Key.Pitch << "\n";
+	}
+	return bool(File);
+}
+
+bool FCameraPath::Load(const std::string& FileName)
+{
+	std::ifstream File(FileName);
+	std::string Header;
+	if (!std::getline(File, Header) || Header != CAMERA_PATH_HEADER)
+	{
+		return false;
+	}
+
+	std::vector<FCameraKey> Loaded;
+	FCameraKey Key;
+	while (File >> Key.Time >> Key.Position.x >> Key.Position.y >> Key.Position.z >> Key.Yaw >> Key.Pitch)
+	{
+		// Keys have to be ordered by time for the search in Evaluate.
+		if (!Loaded.empty() && Key.Time < Loaded.back().Time)
+		{
+			return false;
+		}
+		Loaded.push_back(Key);
+	}
+
+	if (!File.eof() || Loaded.empty())
+	{
+		return false;
+	}
+
+	StopRecording();
+	StopPlayback();
+	Keys = std::move(Loaded);
+	return true;
+}
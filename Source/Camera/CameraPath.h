@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Camera/Camera.h"
+
+// Minimal time between recorded keys in seconds, spline fills in between.
+#define CAMERA_PATH_SAMPLE_INTERVAL 0.1
+// Simulated time of one playback frame, independent of the real frame rate.
+#define CAMERA_PATH_TIMESTEP (1.0 / 60.0)
+
+struct FCameraKey
+{
+	// Seconds since the recording started.
+	double Time = 0.;
+	glm::vec3 Position = glm::vec3(0.f);
+	double Yaw = 0.;
+	double Pitch = 0.;
+};
+
+// Camera flythrough recorded from live input and replayed deterministically,
+// so benchmark runs on different builds and machines see the same views.
+class FCameraPath
+{
+public:
+
+	void StartRecording(double Time);
+	void StopRecording();
+	bool IsRecording() const { return bRecording; };
+	// Adds key if at least CAMERA_PATH_SAMPLE_INTERVAL passed since the last one.
+	void Record(double Time, const FCamera& Camera);
+
+	// Returns false if there is nothing to play.
+	bool StartPlayback();
+	void StopPlayback();
+	bool IsPlaying() const { return bPlaying; };
+	// Moves the camera to the current playback time and advances it by CAMERA_PATH_TIMESTEP, stops after the last key.
+	void Step(FCamera& Camera);
+
+	// Places camera on Catmull-Rom spline through the keys, time is clamped to the path.
+	void Evaluate(double Time, FCamera& Camera) const;
+
+	// Text file, one key per line : time, position, yaw, pitch.
+	bool Save(const std::string& FileName) const;
+	bool Load(const std::string& FileName);
+
+	double GetDuration() const { return Keys.empty() ? 0. : Keys.back().Time; };
+	double GetPlaybackTime() const { return PlaybackTime; };
+	size_t GetKeysNum() const { return Keys.size(); };
+
+private:
+
+	std::vector<FCameraKey> Keys;
+
+	bool bRecording = false;
+	double RecordingStart = 0.;
+
+	bool bPlaying = false;
+	double PlaybackTime = 0.;
+};
@@ -1,9 +1,170 @@
 #include <iostream>
+#include <sstream>
+#include <string>
 #include "Application.h"
 
+namespace
+{
+	bool ParseInt(const std::string& Text, int& Value)
+	{
+		std::istringstream Stream(Text);
+		return (Stream >> Value) && Stream.eof();
+	}
+
+	bool ParseFloat(const std::string& Text, float& Value)
+	{
+		std::istringstream Stream(Text);
+		return (Stream >> Value) && Stream.eof();
+	}
+
+	// "<width>x<height>", also used for light grid "<columns>x<rows>".
+	bool ParseSize(const std::string& Text, int& Width, int& Height)
+	{
+		const size_t Separator = Text.find('x');
+		return Separator != std::string::npos && ParseInt(Text.substr(0, Separator), Width) && ParseInt(Text.substr(Separator + 1), Height);
+	}
+
+	void PrintUsage()
+	{
+		std::cout << "Usage: PBR [options]\n"
+			"  --dump-shaders            write preprocessed shaders for Tools/optimize_shaders.py\n"
+			"  --gl-debug                create debug context and show driver performance warnings\n"
+			"  --render-on-demand        redraw only after input or while loading\n"
+			"  --single-thread           build and render frames on the main thread\n"
+			"  --benchmark               render offscreen, write per frame times and exit\n"
+			"  --context native|egl|osmesa\n"
+			"  --resolution <w>x<h>      benchmark framebuffer size\n"
+			"  --warmup <frames>         frames drawn before measuring\n"
+			"  --frames <frames>         measured frames\n"
+			"  --output <file.csv>\n"
+			"  --scene demo|study|materials\n"
+			"  --shader <index>          shader of study scene, 0 - 6\n"
+			"  --lights <columns>x<rows>\n"
+			"  --segments <n>            sphere segments\n"
+			"  --depth-prepass           depth pre-pass in the scene\n"
+			"  --dynamic-resolution <ms> scale scene resolution to reach the GPU frame time\n"
+			"  --camera-path <file>      camera path replayed by benchmark, saved and loaded from GUI\n"
+			"  --capture-golden <dir>    render canonical views of every shader as golden images and exit\n"
+			"  --compare-golden <dir>    compare the same views against golden images, non-zero exit code on mismatch\n";
+	}
+}
+
 int main(int argc, char** argv)
 {
-	Application App;
-	App.Run();
-	return 0;
+	FApplicationOptions Options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string Argument = argv[i];
+		const std::string Value = i + 1 < argc ? argv[i + 1] : "";
+
+		bool bValid = true;
+
+		// Preprocessed shaders for Tools/optimize_shaders.py.
+		if (Argument == "--dump-shaders")
+		{
+			FShader::SetDumpPreprocessed(true);
+		}
+		else if (Argument == "--gl-debug")
+		{
+			Options.bDebugContext = true;
+		}
+		else if (Argument == "--render-on-demand")
+		{
+			Options.bRenderOnDemand = true;
+		}
+		else if (Argument == "--dynamic-resolution")
+		{
+			Options.bDynamicResolution = true;
+			bValid = ParseFloat(Value, Options.TargetFrameTime) && Options.TargetFrameTime > 0.f;
+			++i;
+		}
+		else if (Argument == "--depth-prepass")
+		{
+			Options.bDepthPrepass = true;
+		}
+		else if (Argument == "--single-thread")
+		{
+			Options.bSingleThreaded = true;
+		}
+		else if (Argument == "--benchmark")
+		{
+			Options.bBenchmark = true;
+		}
+		else if (Argument == "--context")
+		{
+			bValid = Value == "native" || Value == "egl" || Value == "osmesa";
+			Options.ContextApi = Value == "egl" ? EContextApi::EEGL : Value == "osmesa" ? EContextApi::EOSMesa : EContextApi::ENative;
+			++i;
+		}
+		else if (Argument == "--resolution")
+		{
+			bValid = ParseSize(Value, Options.BenchmarkWidth, Options.BenchmarkHeight);
+			++i;
+		}
+		else if (Argument == "--warmup")
+		{
+			bValid = ParseInt(Value, Options.WarmupFrames) && Options.WarmupFrames >= 0;
+			++i;
+		}
+		else if (Argument == "--frames")
+		{
+			bValid = ParseInt(Value, Options.BenchmarkFrames) && Options.BenchmarkFrames > 0;
+			++i;
+		}
+		else if (Argument == "--output")
+		{
+			bValid = !Value.empty();
+			Options.BenchmarkOutput = Value;
+			++i;
+		}
+		else if (Argument == "--scene")
+		{
+			bValid = Value == "demo" || Value == "study" || Value == "materials";
+			Options.Scene = Value == "study" ? EScene::EStudy : Value == "materials" ? EScene::EMaterials : EScene::EDemo;
+			++i;
+		}
+		else if (Argument == "--shader")
+		{
+			bValid = ParseInt(Value, Options.Shader) && Options.Shader >= 0 && Options.Shader < STUDY_SHADERS;
+			++i;
+		}
+		else if (Argument == "--lights")
+		{
+			bValid = ParseSize(Value, Options.LightsColumns, Options.LightsRows);
+			++i;
+		}
+		else if (Argument == "--segments")
+		{
+			bValid = ParseInt(Value, Options.SphereSegments) && Options.SphereSegments > 0;
+			++i;
+		}
+		else if (Argument == "--camera-path")
+		{
+			bValid = !Value.empty();
+			Options.CameraPath = Value;
+			++i;
+		}
+		else if (Argument == "--capture-golden" || Argument == "--compare-golden")
+		{
+			bValid = !Value.empty();
+			Options.GoldenMode = Argument == "--capture-golden" ? EGoldenMode::ECapture : EGoldenMode::ECompare;
+			Options.GoldenDirectory = Value;
+			++i;
+		}
+		else
+		{
+			bValid = false;
+		}
+
+		if (!bValid)
+		{
+			std::cout << "Invalid argument " << Argument << std::endl;
+			PrintUsage();
+			return 2;
+		}
+	}
+
+	Application App(Options);
+	return App.Run();
 }
@@ -3,6 +3,8 @@
 #include <glad/glad.h>
 #include "glm/glm.hpp"
 
+#include "Render/StateCache.h"
+
 #include <iostream>
 
 
@@ -11,6 +13,7 @@ void FSphere::GetData(std::vector<float>& Data,std::vector<unsigned int>& Indice
 	std::vector<glm::vec3> Positions;
 	std::vector<glm::vec3> Normals;
 	std::vector<glm::vec2> UV;
+	std::vector<glm::vec4> Tangents;
 
 	const float PI = 3.14159265359f;
 	for (unsigned int x = 0; x <= inSegments; ++x)
@@ -26,6 +29,9 @@ void FSphere::GetData(std::vector<float>& Data,std::vector<unsigned int>& Indice
 			Positions.push_back(glm::vec3(xPos, yPos, zPos));
 			UV.push_back(glm::vec2(xSegment, ySegment));
 			Normals.push_back(glm::vec3(xPos, yPos, zPos));
+			// Derivative of position along U, well defined at the poles too.
+			// Images are stored top row first, so image up (normal map green) points along -V.
+			Tangents.push_back(glm::vec4(-std::sin(xSegment * 2.0f * PI), 0.f, std::cos(xSegment * 2.0f * PI), -1.f));
 		}
 	}
 
@@ -65,18 +71,25 @@ void FSphere::GetData(std::vector<float>& Data,std::vector<unsigned int>& Indice
 
 		Data.push_back(UV[i].x);
 		Data.push_back(UV[i].y);
+
+		Data.push_back(Tangents[i].x);
+		Data.push_back(Tangents[i].y);
+		Data.push_back(Tangents[i].z);
+		Data.push_back(Tangents[i].w);
 	}
 }
 
 void FSphere::Init(unsigned int inSegments)
 {
-	unsigned int VBO = 0;
-	unsigned int EBO = 0;
+	// Segments changed in GUI, the old mesh is replaced.
+	ReleaseBuffers();
 
 	glGenVertexArrays(1, &SphereVAO);
+	glGenVertexArrays(1, &DepthVAO);
 
 	glGenBuffers(1, &VBO);
 	glGenBuffers(1, &EBO);
+	glGenBuffers(1, &PositionVBO);
 
 	std::vector<unsigned int> Indices;
 	std::vector<float> Data;
@@ -84,13 +97,13 @@ void FSphere::Init(unsigned int inSegments)
 
 	IndexCount = static_cast<unsigned int>(Indices.size());
 
-	glBindVertexArray(SphereVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	FStateCache::Get().BindVertexArray(SphereVAO);
+	FStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBufferData(GL_ARRAY_BUFFER, Data.size() * sizeof(float), &Data[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	FStateCache::Get().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, Indices.size() * sizeof(unsigned int), &Indices[0], GL_STATIC_DRAW);
 
-	unsigned int Stride = (3 + 3 + 2) * sizeof(float);
+	unsigned int Stride = (3 + 3 + 2 + 4) * sizeof(float);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Stride, (void*)0);
 
@@ -100,24 +113,77 @@ void FSphere::Init(unsigned int inSegments)
 	glEnableVertexAttribArray(2);
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, Stride, (void*)(6 * sizeof(float)));
 
-	Textures[0].LoadTextureFromFile("Textures/rustediron2_albedo.png");
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, Stride, (void*)(8 * sizeof(float)));
+
+	if (InstanceVBO)
+	{
+		BindInstanceAttribute();
+	}
+
+	// Quarter of the vertex data for the depth pre-pass.
+	std::vector<float> Positions;
+	Positions.reserve(Data.size() / 4);
+	for (size_t i = 0; i < Data.size(); i += Stride / sizeof(float))
+	{
+		Positions.insert(Positions.end(), Data.begin() + i, Data.begin() + i + 3);
+	}
+
+	FStateCache::Get().BindVertexArray(DepthVAO);
+	FStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, PositionVBO);
+	glBufferData(GL_ARRAY_BUFFER, Positions.size() * sizeof(float), Positions.data(), GL_STATIC_DRAW);
+	FStateCache::Get().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+
+	if (InstanceVBO)
+	{
+		BindInstanceAttribute();
+	}
+}
+
+void FSphere::ReleaseBuffers()
+{
+	if (!SphereVAO)
+	{
+		return;
+	}
+
+	const GLuint VertexArrays[] = { SphereVAO, DepthVAO };
+	FStateCache::Get().DeleteVertexArrays(2, VertexArrays);
+	const GLuint Buffers[] = { VBO, EBO, PositionVBO };
+	FStateCache::Get().DeleteBuffers(3, Buffers);
+
+	SphereVAO = DepthVAO = 0;
+	VBO = EBO = PositionVBO = 0;
+}
+
+void FSphere::LoadTextures()
+{
+	Textures[0].LoadTextureFromFile("Textures/rustediron2_albedo.png", ETextureColorSpace::ESRGB);
 	Textures[1].LoadTextureFromFile("Textures/rustediron2_normal.png");
 	Textures[2].LoadTextureFromFile("Textures/rustediron2_metallic.png");
 	Textures[3].LoadTextureFromFile("Textures/rustediron2_roughness.png");
 }
 
+void FSphere::ReleaseTextures()
+{
+	for (FTexture& Texture : Textures)
+	{
+		Texture.Release();
+	}
+}
+
 void FSphere::Draw()
 {
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, Textures[0].GetID());
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, Textures[1].GetID());
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, Textures[2].GetID());
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, Textures[3].GetID());
+	FStateCache& State = FStateCache::Get();
+	for (size_t i = 0; i < Textures.size(); ++i)
+	{
+		State.BindTexture(static_cast<GLuint>(i), GL_TEXTURE_2D, Textures[i].GetID());
+	}
 
-	glBindVertexArray(SphereVAO);
+	State.BindVertexArray(SphereVAO);
 
 	glDrawElements(GL_TRIANGLE_STRIP, IndexCount, GL_UNSIGNED_INT, 0);
 }
@@ -126,3 +192,78 @@ size_t FSphere::GetSize()
 {
 	return VerticesNum;
 }
+
+void FSphere::DrawDepth()
+{
+	FStateCache::Get().BindVertexArray(DepthVAO);
+
+	glDrawElements(GL_TRIANGLE_STRIP, IndexCount, GL_UNSIGNED_INT, 0);
+}
+
+void FSphere::DrawDepthInstanced()
+{
+	FStateCache::Get().BindVertexArray(DepthVAO);
+
+	glDrawElementsInstanced(GL_TRIANGLE_STRIP, IndexCount, GL_UNSIGNED_INT, 0, InstanceCount);
+}
+
+bool FSphere::InitMaterials(const std::vector<std::string>& Materials)
+{
+	const std::array<const char*, 4> Suffixes = { "_albedo.png", "_normal.png", "_metallic.png", "_roughness.png" };
+
+	for (size_t i = 0; i < MaterialArrays.size(); ++i)
+	{
+		std::vector<std::string> FileNames;
+		for (const std::string& Material : Materials)
+		{
+			FileNames.push_back(Material + Suffixes[i]);
+		}
+
+		if (!MaterialArrays[i].LoadTexturesFromFiles(FileNames, i == 0 ? ETextureColorSpace::ESRGB : ETextureColorSpace::ELinear))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void FSphere::SetInstances(const std::vector<glm::vec4>& Instances)
+{
+	if (!InstanceVBO)
+	{
+		glGenBuffers(1, &InstanceVBO);
+	}
+
+	FStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, InstanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, Instances.size() * sizeof(glm::vec4), Instances.data(), GL_STATIC_DRAW);
+
+	for (unsigned int VAO : { SphereVAO, DepthVAO })
+	{
+		FStateCache::Get().BindVertexArray(VAO);
+		BindInstanceAttribute();
+	}
+
+	InstanceCount = static_cast<unsigned int>(Instances.size());
+}
+
+void FSphere::BindInstanceAttribute()
+{
+	FStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, InstanceVBO);
+	glEnableVertexAttribArray(4);
+	glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+	glVertexAttribDivisor(4, 1);
+}
+
+void FSphere::DrawInstanced()
+{
+	FStateCache& State = FStateCache::Get();
+	for (size_t i = 0; i < MaterialArrays.size(); ++i)
+	{
+		State.BindTexture(static_cast<GLuint>(i), GL_TEXTURE_2D_ARRAY, MaterialArrays[i].GetID());
+	}
+
+	State.BindVertexArray(SphereVAO);
+
+	glDrawElementsInstanced(GL_TRIANGLE_STRIP, IndexCount, GL_UNSIGNED_INT, 0, InstanceCount);
+}
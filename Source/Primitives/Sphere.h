@@ -1,9 +1,13 @@
 #pragma once
 
 #include <array>
+#include <string>
 #include <vector>
 
+#include "glm/glm.hpp"
+
 #include "Texture/Texture.h"
+#include "Texture/TextureArray.h"
 
 
 class FSphere
@@ -16,15 +20,44 @@ public:
 	//	vec3 - pos
 	//	vec3 - normal
 	//	vec2 - uv
+	//	vec4 - tangent, w is the bitangent sign (B = cross(N, T) * w)
 	void Init(unsigned int inSegments);
 	void Draw();
 	size_t GetSize();
 
+	// Full material textures, not needed while they are virtual textures.
+	void LoadTextures();
+	void ReleaseTextures();
+
+	// Depth pre-pass reads tightly packed positions (vec3) only, same indices.
+	void DrawDepth();
+	void DrawDepthInstanced();
+
+	// Loads material texture arrays, layer i holds maps of Materials[i]
+	// (Materials[i] + "_albedo.png", "_normal.png", "_metallic.png", "_roughness.png").
+	bool InitMaterials(const std::vector<std::string>& Materials);
+	int GetMaterialsNum() const { return MaterialArrays[0].GetLayers(); };
+
+	// Per instance attribute (location 4) :
+	//	vec3 - offset
+	//	float - material layer
+	void SetInstances(const std::vector<glm::vec4>& Instances);
+	// Draws all instances with material arrays bound, one draw call for every material.
+	void DrawInstanced();
+
 private:
 
 	void GetData(std::vector<float>& Data, std::vector<unsigned int>& Indices, unsigned int inSegments);
+	void BindInstanceAttribute();
+
+	// Deletes the vertex arrays and buffers of the last Init.
+	void ReleaseBuffers();
 
 	unsigned int SphereVAO = 0;
+	unsigned int DepthVAO = 0;
+	unsigned int VBO = 0;
+	unsigned int EBO = 0;
+	unsigned int PositionVBO = 0;
 	unsigned int IndexCount = 0;
 	size_t VerticesNum = 0;
 
@@ -33,4 +66,10 @@ private:
 	// Metallic
 	// Roughness
 	std::array<FTexture, 4> Textures;
+
+	// Same maps as above, one layer per material.
+	std::array<FTextureArray, 4> MaterialArrays;
+
+	unsigned int InstanceVBO = 0;
+	unsigned int InstanceCount = 0;
 };
\ No newline at end of file
@@ -0,0 +1,300 @@
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+namespace
+{
+	const std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+
+	std::string EscapeJson(const std::string& Text)
+	{
+		std::string Result;
+		for (char Character : Text)
+		{
+			if (Character == '"' || Character == '\\')
+			{
+				Result += '\\';
+			}
+			Result += Character;
+		}
+		return Result;
+	}
+}
+
+FCpuProfiler& FCpuProfiler::Get()
+{
+	static FCpuProfiler Profiler;
+	return Profiler;
+}
+
+int64_t FCpuProfiler::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - StartTime).count();
+}
+
+FCpuProfiler::FThreadBuffer& FCpuProfiler::GetThreadBuffer()
+{
+	thread_local FThreadBuffer* Buffer = nullptr;
+
+	if (!Buffer)
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		Buffers.emplace_back(new FThreadBuffer());
+		Buffer = Buffers.back().get();
+		Buffer->Index = static_cast<uint32_t>(Buffers.size() - 1);
+		Buffer->Name = "Thread " + std::to_string(Buffer->Index);
+	}
+
+	return *Buffer;
+}
+
+void FCpuProfiler::SetThreadName(const std::string& Name)
+{
+	FThreadBuffer& Buffer = GetThreadBuffer();
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+	Buffer.Name = Name;
+}
+
+void FCpuProfiler::PushScope()
+{
+	++GetThreadBuffer().Depth;
+}
+
+void FCpuProfiler::PopScope(const char* Name, int64_t Begin)
+{
+	FThreadBuffer& Buffer = GetThreadBuffer();
+	--Buffer.Depth;
+
+	const uint64_t Write = Buffer.WriteIndex.load(std::memory_order_relaxed);
+	const uint64_t Read = Buffer.ReadIndex.load(std::memory_order_acquire);
+	if (Write - Read >= CPU_PROFILER_BUFFER_EVENTS)
+	{
+		Buffer.Dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	FCpuEvent& Event = Buffer.Events[Write % CPU_PROFILER_BUFFER_EVENTS];
+	Event.Name = Name;
+	Event.Begin = Begin;
+	Event.End = Now();
+	Event.Depth = Buffer.Depth;
+	Event.Thread = Buffer.Index;
+
+	Buffer.WriteIndex.store(Write + 1, std::memory_order_release);
+}
+
+void FCpuProfiler::BeginFrame()
+{
+	const int64_t FrameEnd = Now();
+	FrameThread = GetThreadBuffer().Index;
+
+	std::vector<FThreadBuffer*> ThreadBuffers;
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		for (const std::unique_ptr<FThreadBuffer>& Buffer : Buffers)
+		{
+			ThreadBuffers.push_back(Buffer.get());
+		}
+	}
+
+	FrameEvents.clear();
+	for (FThreadBuffer* Buffer : ThreadBuffers)
+	{
+		const uint64_t Write = Buffer->WriteIndex.load(std::memory_order_acquire);
+		const uint64_t Read = Buffer->ReadIndex.load(std::memory_order_relaxed);
+		for (uint64_t i = Read; i < Write; ++i)
+		{
+			FrameEvents.push_back(Buffer->Events[i % CPU_PROFILER_BUFFER_EVENTS]);
+		}
+		Buffer->ReadIndex.store(Write, std::memory_order_release);
+
+		DroppedEvents += Buffer->Dropped.exchange(0, std::memory_order_relaxed);
+	}
+
+	if (FrameBegin >= 0)
+	{
+		UpdateSummary(FrameBegin, FrameEnd);
+	}
+
+	if (CaptureFrames > 0)
+	{
+		// Capture starts at the first frame boundary after the request.
+		if (CaptureBegin < 0)
+		{
+			CaptureBegin = FrameEnd;
+		}
+		else
+		{
+			for (const FCpuEvent& Event : FrameEvents)
+			{
+				if (Event.Begin >= CaptureBegin)
+				{
+					CaptureEvents.push_back(Event);
+				}
+			}
+
+			if (--CaptureFrames == 0)
+			{
+				WriteCapture();
+			}
+		}
+
+		CaptureFrameBoundaries.push_back(FrameEnd);
+	}
+
+	FrameBegin = FrameEnd;
+}
+
+void FCpuProfiler::UpdateSummary(int64_t inFrameBegin, int64_t FrameEnd)
+{
+	std::vector<std::string> ThreadNames;
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		for (const std::unique_ptr<FThreadBuffer>& Buffer : Buffers)
+		{
+			ThreadNames.push_back(Buffer->Name);
+		}
+	}
+
+	// Grouped by thread, the frame thread first. Parents begin before their children.
+	std::vector<FCpuEvent> Events = FrameEvents;
+	const uint32_t First = FrameThread;
+	std::sort(Events.begin(), Events.end(), [First](const FCpuEvent& A, const FCpuEvent& B)
+	{
+		if (A.Thread != B.Thread)
+		{
+			return A.Thread == First || (B.Thread != First && A.Thread < B.Thread);
+		}
+		return A.Begin < B.Begin || (A.Begin == B.Begin && A.Depth < B.Depth);
+	});
+
+	const size_t OldNodes = Summary.size();
+	std::fill(SummaryFrameTimes.begin(), SummaryFrameTimes.end(), 0.f);
+	std::fill(SummaryFrameCalls.begin(), SummaryFrameCalls.end(), 0);
+
+	auto FindNode = [this](int Parent, const std::string& Name)
+	{
+		auto Found = SummaryIndices.find(std::make_pair(Parent, Name));
+		if (Found == SummaryIndices.end())
+		{
+			Found = SummaryIndices.emplace(std::make_pair(Parent, Name), int(Summary.size())).first;
+
+			FCpuSummaryNode Node;
+			Node.Name = Name;
+			Node.Parent = Parent;
+			Summary.push_back(Node);
+			SummaryFrameTimes.push_back(0.f);
+			SummaryFrameCalls.push_back(0);
+		}
+		return Found->second;
+	};
+
+	// Node of the thread and nodes of the scopes enclosing the current event.
+	int ThreadNode = -1;
+	uint32_t Thread = 0;
+	std::vector<int> Path;
+	for (const FCpuEvent& Event : Events)
+	{
+		if (ThreadNode < 0 || Event.Thread != Thread)
+		{
+			Thread = Event.Thread;
+			ThreadNode = FindNode(-1, Thread < ThreadNames.size() ? ThreadNames[Thread] : "Thread " + std::to_string(Thread));
+			Path.clear();
+		}
+
+		Path.resize(std::min<size_t>(Event.Depth, Path.size()));
+		const int Index = FindNode(Path.empty() ? ThreadNode : Path.back(), Event.Name);
+
+		const float Time = float(double(Event.End - Event.Begin) / 1e6);
+		SummaryFrameTimes[Index] += Time;
+		++SummaryFrameCalls[Index];
+		if (Event.Depth == 0)
+		{
+			SummaryFrameTimes[ThreadNode] += Time;
+			++SummaryFrameCalls[ThreadNode];
+		}
+		Path.push_back(Index);
+	}
+
+	for (size_t i = 0; i < Summary.size(); ++i)
+	{
+		FCpuSummaryNode& Node = Summary[i];
+		if (i >= OldNodes)
+		{
+			Node.Average = SummaryFrameTimes[i];
+			Node.Calls = float(SummaryFrameCalls[i]);
+		}
+		else
+		{
+			Node.Average += (SummaryFrameTimes[i] - Node.Average) * CPU_PROFILER_SMOOTHING;
+			Node.Calls += (SummaryFrameCalls[i] - Node.Calls) * CPU_PROFILER_SMOOTHING;
+		}
+	}
+
+	const float LastFrameTime = float(double(FrameEnd - inFrameBegin) / 1e6);
+	FrameTime = FrameTime == 0.f ? LastFrameTime : FrameTime + (LastFrameTime - FrameTime) * CPU_PROFILER_SMOOTHING;
+}
+
+void FCpuProfiler::StartCapture(int Frames, const std::string& FileName)
+{
+	CaptureFrames = std::max(Frames, 1);
+	CaptureBegin = -1;
+	CaptureFileName = FileName;
+	CaptureEvents.clear();
+	CaptureFrameBoundaries.clear();
+	CaptureStatus = "Capturing...";
+}
+
+void FCpuProfiler::WriteCapture()
+{
+	std::ofstream File(CaptureFileName);
+	if (!File)
+	{
+		CaptureStatus = "Failed to write " + CaptureFileName;
+		return;
+	}
+
+	auto Microseconds = [this](int64_t Time) { return double(Time - CaptureBegin) / 1e3; };
+
+	File << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	// JSON has no trailing commas, every event but the first is preceded by one.
+	const char* Separator = "\n";
+
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		for (const std::unique_ptr<FThreadBuffer>& Buffer : Buffers)
+		{
+			File << Separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << Buffer->Index
+				<< ",\"args\":{\"name\":\"" << EscapeJson(Buffer->Name) << "\"}}";
+			Separator = ",\n";
+		}
+	}
+
+	File.precision(3);
+	File << std::fixed;
+
+	for (int64_t Boundary : CaptureFrameBoundaries)
+	{
+		File << Separator << "{\"name\":\"Frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":" << FrameThread
+			<< ",\"ts\":" << Microseconds(Boundary) << "}";
+		Separator = ",\n";
+	}
+
+	for (const FCpuEvent& Event : CaptureEvents)
+	{
+		File << Separator << "{\"name\":\"" << EscapeJson(Event.Name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << Event.Thread
+			<< ",\"ts\":" << Microseconds(Event.Begin) << ",\"dur\":" << double(Event.End - Event.Begin) / 1e3 << "}";
+		Separator = ",\n";
+	}
+
+	File << "\n]}\n";
+
+	CaptureStatus = "Wrote " + std::to_string(CaptureEvents.size()) + " events to " + CaptureFileName;
+	CaptureEvents.clear();
+	CaptureFrameBoundaries.clear();
+}
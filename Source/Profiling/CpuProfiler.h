@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Set to 0 to compile all the markers out.
+#ifndef CPU_PROFILER
+#define CPU_PROFILER 1
+#endif
+
+// Events a thread may record between two frame boundaries, the rest is dropped.
+#define CPU_PROFILER_BUFFER_EVENTS (1 << 15)
+// Weight of the last frame in the averages of the summary.
+#define CPU_PROFILER_SMOOTHING 0.05f
+
+#if CPU_PROFILER
+#define CPU_PROFILER_CONCAT_(A, B) A##B
+#define CPU_PROFILER_CONCAT(A, B) CPU_PROFILER_CONCAT_(A, B)
+// Name has to be a string literal, only the pointer is stored.
+#define CPU_SCOPE(Name) FCpuScope CPU_PROFILER_CONCAT(CpuScope, __LINE__)(Name)
+#define CPU_FRAME() FCpuProfiler::Get().BeginFrame()
+#define CPU_THREAD_NAME(Name) FCpuProfiler::Get().SetThreadName(Name)
+#else
+#define CPU_SCOPE(Name)
+#define CPU_FRAME()
+#define CPU_THREAD_NAME(Name)
+#endif
+
+struct FCpuEvent
+{
+	const char* Name = nullptr;
+	// Nanoseconds since the profiler start.
+	int64_t Begin = 0;
+	int64_t End = 0;
+	// Number of enclosing scopes on the same thread.
+	uint32_t Depth = 0;
+	uint32_t Thread = 0;
+};
+
+// Node of the call tree of every thread, averaged over frames.
+struct FCpuSummaryNode
+{
+	// Scope name, or thread name for the top level nodes.
+	std::string Name;
+	// Index of the enclosing node, -1 for the threads, whose time is the sum of their top level scopes.
+	int Parent = -1;
+	// Milliseconds per frame including children.
+	float Average = 0.f;
+	float Calls = 0.f;
+};
+
+// Scoped CPU markers of every thread.
+// Threads write completed scopes into their own ring buffer without locks, the thread calling BeginFrame
+// drains all the buffers once per frame, builds the summary and appends to a capture if one is running.
+class FCpuProfiler
+{
+public:
+
+	static FCpuProfiler& Get();
+
+	static int64_t Now();
+
+	// Frame boundary, call from the main loop outside of any scope.
+	void BeginFrame();
+
+	void SetThreadName(const std::string& Name);
+
+	// Records the next Frames frames and writes them to FileName as Chrome trace JSON (chrome://tracing, Perfetto).
+	void StartCapture(int Frames, const std::string& FileName);
+	bool IsCapturing() const { return CaptureFrames > 0; };
+	// Result of the last finished capture.
+	const std::string& GetCaptureStatus() const { return CaptureStatus; };
+
+	const std::vector<FCpuSummaryNode>& GetSummary() const { return Summary; };
+	float GetFrameTime() const { return FrameTime; };
+	int GetDroppedEvents() const { return DroppedEvents; };
+
+	// Called by FCpuScope.
+	void PushScope();
+	void PopScope(const char* Name, int64_t Begin);
+
+private:
+
+	// Single producer (owning thread), single consumer (frame thread) ring.
+	struct FThreadBuffer
+	{
+		std::unique_ptr<FCpuEvent[]> Events{ new FCpuEvent[CPU_PROFILER_BUFFER_EVENTS] };
+		std::atomic<uint64_t> WriteIndex{ 0 };
+		std::atomic<uint64_t> ReadIndex{ 0 };
+		std::atomic<int> Dropped{ 0 };
+		uint32_t Depth = 0;
+		uint32_t Index = 0;
+		std::string Name;
+	};
+
+	FCpuProfiler() = default;
+
+	FThreadBuffer& GetThreadBuffer();
+	void UpdateSummary(int64_t FrameBegin, int64_t FrameEnd);
+	void WriteCapture();
+
+	// Guards registration of threads only.
+	std::mutex Mutex;
+	std::vector<std::unique_ptr<FThreadBuffer>> Buffers;
+
+	uint32_t FrameThread = 0;
+	int64_t FrameBegin = -1;
+	std::vector<FCpuEvent> FrameEvents;
+
+	std::vector<FCpuSummaryNode> Summary;
+	std::vector<float> SummaryFrameTimes;
+	std::vector<int> SummaryFrameCalls;
+	std::map<std::pair<int, std::string>, int> SummaryIndices;
+	float FrameTime = 0.f;
+	int DroppedEvents = 0;
+
+	int CaptureFrames = 0;
+	int64_t CaptureBegin = 0;
+	std::string CaptureFileName;
+	std::vector<FCpuEvent> CaptureEvents;
+	std::vector<int64_t> CaptureFrameBoundaries;
+	std::string CaptureStatus;
+};
+
+// Records the enclosing scope.
+class FCpuScope
+{
+public:
+	explicit FCpuScope(const char* inName)
+		:Name(inName), Begin(FCpuProfiler::Now())
+	{
+		FCpuProfiler::Get().PushScope();
+	}
+	~FCpuScope()
+	{
+		FCpuProfiler::Get().PopScope(Name, Begin);
+	}
+
+	FCpuScope(const FCpuScope&) = delete;
+	FCpuScope& operator=(const FCpuScope&) = delete;
+
+private:
+	const char* Name;
+	int64_t Begin;
+};
@@ -0,0 +1,188 @@
+#include "DebugOutput.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <iterator>
+
+namespace
+{
+	const GLenum DebugSources[] =
+	{
+		GL_DEBUG_SOURCE_API,
+		GL_DEBUG_SOURCE_WINDOW_SYSTEM,
+		GL_DEBUG_SOURCE_SHADER_COMPILER,
+		GL_DEBUG_SOURCE_THIRD_PARTY,
+		GL_DEBUG_SOURCE_APPLICATION,
+		GL_DEBUG_SOURCE_OTHER,
+	};
+
+	const char* DebugSourceNames[] =
+	{
+		"API",
+		"Window System",
+		"Shader Compiler",
+		"Third Party",
+		"Application",
+		"Other",
+	};
+
+	const size_t DebugSourcesNum = sizeof(DebugSources) / sizeof(DebugSources[0]);
+
+	size_t GetSourceIndex(GLenum Source)
+	{
+		const GLenum* Found = std::find(std::begin(DebugSources), std::end(DebugSources), Source);
+		return Found == std::end(DebugSources) ? DebugSourcesNum - 1 : Found - std::begin(DebugSources);
+	}
+}
+
+FDebugOutput::~FDebugOutput()
+{
+	Shutdown();
+}
+
+bool FDebugOutput::Init()
+{
+	Shutdown();
+
+	// Loader has no extensions, on older contexts KHR_debug entry points are fetched directly (no suffix in core profile).
+	if (!GLAD_GL_VERSION_4_3)
+	{
+		if (!glfwExtensionSupported("GL_KHR_debug"))
+		{
+			return false;
+		}
+
+		glad_glDebugMessageCallback = (PFNGLDEBUGMESSAGECALLBACKPROC)glfwGetProcAddress("glDebugMessageCallback");
+		glad_glDebugMessageControl = (PFNGLDEBUGMESSAGECONTROLPROC)glfwGetProcAddress("glDebugMessageControl");
+		if (!glad_glDebugMessageCallback || !glad_glDebugMessageControl)
+		{
+			return false;
+		}
+	}
+
+	SourceCounts.assign(DebugSourcesNum, 0);
+
+	glEnable(GL_DEBUG_OUTPUT);
+	glDebugMessageCallback(&FDebugOutput::Callback, this);
+
+	// Performance warnings only, plus errors which are printed.
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+	glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_PERFORMANCE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+	glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_ERROR, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+
+	bInitialized = true;
+	return true;
+}
+
+void FDebugOutput::Shutdown()
+{
+	if (!bInitialized)
+	{
+		return;
+	}
+
+	glDebugMessageCallback(nullptr, nullptr);
+	glDisable(GL_DEBUG_OUTPUT);
+
+	SetLogFile("");
+	bInitialized = false;
+}
+
+void FDebugOutput::SetLogFile(const std::string& FileName)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	Log.close();
+	if (!FileName.empty())
+	{
+		Log.open(FileName, std::ios::app);
+	}
+}
+
+bool FDebugOutput::IsLogging() const
+{
+	// Callback writes the log on the render thread.
+	std::lock_guard<std::mutex> Lock(Mutex);
+	return Log.is_open();
+}
+
+void APIENTRY FDebugOutput::Callback(GLenum Source, GLenum Type, GLuint Id, GLenum Severity, GLsizei Length, const GLchar* Message, const void* UserParam)
+{
+	FDebugOutput* Output = static_cast<FDebugOutput*>(const_cast<void*>(UserParam));
+	Output->AddMessage(Source, Type, Id, Severity, Length < 0 ? std::string(Message) : std::string(Message, Length));
+}
+
+void FDebugOutput::AddMessage(GLenum Source, GLenum Type, GLuint Id, GLenum Severity, const std::string& Text)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	const size_t SourceIndex = GetSourceIndex(Source);
+	++SourceCounts[SourceIndex];
+
+	if (Type == GL_DEBUG_TYPE_ERROR)
+	{
+		std::cout << "GL error (" << DebugSourceNames[SourceIndex] << ", " << Id << ") : " << Text << std::endl;
+	}
+
+	// Some drivers report every message with id 0, text tells them apart then.
+	const uint64_t Key = (uint64_t(SourceIndex) << 32) | (Id != 0 ? Id : uint32_t(std::hash<std::string>()(Text)));
+
+	auto Found = MessageIndices.find(Key);
+	const bool bNew = Found == MessageIndices.end();
+	if (bNew)
+	{
+		Found = MessageIndices.emplace(Key, Messages.size()).first;
+
+		FDebugMessage Message;
+		Message.Source = Source;
+		Message.SourceName = DebugSourceNames[SourceIndex];
+		Message.Type = Type;
+		Message.Id = Id;
+		Message.Severity = Severity;
+		Message.Text = Text;
+		Messages.push_back(Message);
+	}
+	++Messages[Found->second].Count;
+
+	// Repeated messages would flood the log.
+	if (bNew && Log.is_open())
+	{
+		Log << DebugSourceNames[SourceIndex] << " " << Id << " : " << Text << std::endl;
+	}
+}
+
+std::vector<FDebugMessage> FDebugOutput::GetMessages() const
+{
+	std::vector<FDebugMessage> Result;
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		std::copy_if(Messages.begin(), Messages.end(), std::back_inserter(Result),
+			[](const FDebugMessage& Message) { return Message.Type == GL_DEBUG_TYPE_PERFORMANCE; });
+	}
+
+	std::stable_sort(Result.begin(), Result.end(), [](const FDebugMessage& A, const FDebugMessage& B) { return A.Count > B.Count; });
+	return Result;
+}
+
+std::vector<int> FDebugOutput::GetSourceCounts() const
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	return SourceCounts;
+}
+
+void FDebugOutput::Clear()
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	Messages.clear();
+	MessageIndices.clear();
+	std::fill(SourceCounts.begin(), SourceCounts.end(), 0);
+}
+
+const char* FDebugOutput::GetSourceName(size_t Index)
+{
+	return Index < DebugSourcesNum ? DebugSourceNames[Index] : "";
+}
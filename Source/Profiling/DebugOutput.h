@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+struct FDebugMessage
+{
+	GLenum Source = 0;
+	const char* SourceName = "";
+	GLenum Type = 0;
+	GLuint Id = 0;
+	GLenum Severity = 0;
+	std::string Text;
+	// Number of times the message was reported.
+	int Count = 0;
+};
+
+// Driver messages captured through KHR_debug (core since GL 4.3).
+// Performance warnings are de-duplicated by source and id and counted, errors are printed as well.
+class FDebugOutput
+{
+public:
+
+	~FDebugOutput();
+
+	// Installs the callback into the current context, returns false if KHR_debug is not available.
+	// Drivers report most messages only in a context created with GLFW_OPENGL_DEBUG_CONTEXT.
+	bool Init();
+	void Shutdown();
+
+	bool IsInitialized() const { return bInitialized; };
+
+	// Appends every new message to the file, empty name stops logging.
+	void SetLogFile(const std::string& FileName);
+	bool IsLogging() const;
+
+	// Unique performance warnings, most frequent first.
+	std::vector<FDebugMessage> GetMessages() const;
+	// Reported messages per GL_DEBUG_SOURCE_*, in order of GetSourceName.
+	std::vector<int> GetSourceCounts() const;
+	void Clear();
+
+	static const char* GetSourceName(size_t Index);
+
+private:
+
+	static void APIENTRY Callback(GLenum Source, GLenum Type, GLuint Id, GLenum Severity, GLsizei Length, const GLchar* Message, const void* UserParam);
+	void AddMessage(GLenum Source, GLenum Type, GLuint Id, GLenum Severity, const std::string& Text);
+
+	bool bInitialized = false;
+
+	// Callback may come from a driver thread.
+	mutable std::mutex Mutex;
+	std::vector<FDebugMessage> Messages;
+	std::unordered_map<uint64_t, size_t> MessageIndices;
+	std::vector<int> SourceCounts;
+
+	std::ofstream Log;
+};
@@ -0,0 +1,198 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+
+FGpuProfiler::~FGpuProfiler()
+{
+	Shutdown();
+}
+
+void FGpuProfiler::Init()
+{
+	Shutdown();
+	bInitialized = true;
+}
+
+void FGpuProfiler::Shutdown()
+{
+	if (!bInitialized)
+	{
+		return;
+	}
+
+	for (FFrame& Frame : Frames)
+	{
+		if (!Frame.Queries.empty())
+		{
+			glDeleteQueries(static_cast<GLsizei>(Frame.Queries.size()), Frame.Queries.data());
+		}
+		Frame = FFrame();
+	}
+
+	OpenRanges.clear();
+	Timers.clear();
+	TimerIndices.clear();
+	bInitialized = false;
+}
+
+void FGpuProfiler::BeginFrame()
+{
+	if (!bInitialized)
+	{
+		return;
+	}
+
+	// Unbalanced scopes of the previous frame are dropped.
+	OpenRanges.clear();
+
+	++FrameIndex;
+	FFrame& Frame = Frames[FrameIndex % Frames.size()];
+
+	ReadFrame(Frame);
+
+	Frame.UsedQueries = 0;
+	Frame.Ranges.clear();
+}
+
+void FGpuProfiler::ReadFrame(FFrame& Frame)
+{
+	if (Frame.Ranges.empty())
+	{
+		return;
+	}
+
+	// Results come in order, so if the last one is not there the GPU is more than the latency behind - skip instead of waiting.
+	GLint Available = GL_FALSE;
+	glGetQueryObjectiv(Frame.Queries[Frame.UsedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &Available);
+	if (Available == GL_FALSE)
+	{
+		return;
+	}
+
+	std::vector<GLuint64> Timestamps(Frame.UsedQueries);
+	for (size_t i = 0; i < Frame.UsedQueries; ++i)
+	{
+		glGetQueryObjectui64v(Frame.Queries[i], GL_QUERY_RESULT, &Timestamps[i]);
+	}
+
+	std::vector<float> Times(Timers.size(), 0.f);
+	std::vector<bool> bUsed(Timers.size(), false);
+	for (const FRange& Range : Frame.Ranges)
+	{
+		if (Range.EndQuery == 0)
+		{
+			continue;
+		}
+
+		Times[Range.Timer] += float(double(Timestamps[Range.EndQuery] - Timestamps[Range.BeginQuery]) / 1e6);
+		bUsed[Range.Timer] = true;
+	}
+
+	for (size_t i = 0; i < Timers.size(); ++i)
+	{
+		if (!bUsed[i])
+		{
+			continue;
+		}
+
+		FTimer& Timer = Timers[i];
+		Timer.Last = Times[i];
+		Timer.History[Timer.Samples % GPU_PROFILER_HISTORY] = Times[i];
+		++Timer.Samples;
+	}
+}
+
+size_t FGpuProfiler::AllocateQuery(FFrame& Frame)
+{
+	if (Frame.UsedQueries == Frame.Queries.size())
+	{
+		GLuint Query = 0;
+		glGenQueries(1, &Query);
+		Frame.Queries.push_back(Query);
+	}
+
+	return Frame.UsedQueries++;
+}
+
+void FGpuProfiler::Begin(const std::string& Name)
+{
+	if (!bInitialized)
+	{
+		return;
+	}
+
+	auto Found = TimerIndices.find(Name);
+	if (Found == TimerIndices.end())
+	{
+		Found = TimerIndices.emplace(Name, Timers.size()).first;
+		Timers.emplace_back();
+		Timers.back().Name = Name;
+	}
+
+	FFrame& Frame = Frames[FrameIndex % Frames.size()];
+
+	FRange Range;
+	Range.Timer = Found->second;
+	Range.BeginQuery = AllocateQuery(Frame);
+	glQueryCounter(Frame.Queries[Range.BeginQuery], GL_TIMESTAMP);
+
+	OpenRanges.push_back(Frame.Ranges.size());
+	Frame.Ranges.push_back(Range);
+}
+
+void FGpuProfiler::End()
+{
+	if (!bInitialized || OpenRanges.empty())
+	{
+		return;
+	}
+
+	FFrame& Frame = Frames[FrameIndex % Frames.size()];
+
+	FRange& Range = Frame.Ranges[OpenRanges.back()];
+	OpenRanges.pop_back();
+
+	// Query 0 is always a begin query, so 0 marks unfinished range.
+	Range.EndQuery = AllocateQuery(Frame);
+	glQueryCounter(Frame.Queries[Range.EndQuery], GL_TIMESTAMP);
+}
+
+float FGpuProfiler::GetLast(const std::string& Name) const
+{
+	auto Found = TimerIndices.find(Name);
+	return Found != TimerIndices.end() ? Timers[Found->second].Last : 0.f;
+}
+
+std::vector<FGpuTimerStats> FGpuProfiler::GetStats() const
+{
+	std::vector<FGpuTimerStats> Result;
+
+	for (const FTimer& Timer : Timers)
+	{
+		const size_t Count = std::min<size_t>(Timer.Samples, GPU_PROFILER_HISTORY);
+		if (Count == 0)
+		{
+			continue;
+		}
+
+		std::vector<float> Samples(Timer.History.begin(), Timer.History.begin() + Count);
+
+		FGpuTimerStats Stats;
+		Stats.Name = Timer.Name;
+		Stats.Last = Timer.Last;
+
+		for (float Sample : Samples)
+		{
+			Stats.Average += Sample;
+		}
+		Stats.Average /= Count;
+
+		const size_t P95Index = std::min(Count - 1, size_t(0.95f * Count));
+		std::nth_element(Samples.begin(), Samples.begin() + P95Index, Samples.end());
+		Stats.P95 = Samples[P95Index];
+
+		Result.push_back(Stats);
+	}
+
+	return Result;
+}
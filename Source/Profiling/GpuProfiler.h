@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Frames between issuing the queries and reading them back, so reading never waits for the GPU.
+#define GPU_PROFILER_LATENCY 4
+// Samples kept per timer for the rolling average and percentile.
+#define GPU_PROFILER_HISTORY 128
+
+struct FGpuTimerStats
+{
+	std::string Name;
+	// Milliseconds.
+	float Last = 0.f;
+	float Average = 0.f;
+	float P95 = 0.f;
+};
+
+// GPU time of named scopes measured with GL_TIMESTAMP query pairs (nest unlike GL_TIME_ELAPSED).
+// Scopes with the same name are summed within a frame.
+class FGpuProfiler
+{
+public:
+
+	~FGpuProfiler();
+
+	void Init();
+	void Shutdown();
+
+	// Reads back the frame issued GPU_PROFILER_LATENCY frames ago and starts recording a new one.
+	void BeginFrame();
+
+	void Begin(const std::string& Name);
+	void End();
+
+	// Timers in order of first use.
+	std::vector<FGpuTimerStats> GetStats() const;
+	// Milliseconds of the last frame read back, zero before the first one.
+	float GetLast(const std::string& Name) const;
+
+private:
+
+	struct FRange
+	{
+		size_t Timer = 0;
+		size_t BeginQuery = 0;
+		size_t EndQuery = 0;
+	};
+
+	struct FFrame
+	{
+		std::vector<GLuint> Queries;
+		size_t UsedQueries = 0;
+		std::vector<FRange> Ranges;
+	};
+
+	struct FTimer
+	{
+		std::string Name;
+		std::array<float, GPU_PROFILER_HISTORY> History = {};
+		size_t Samples = 0;
+		float Last = 0.f;
+	};
+
+	size_t AllocateQuery(FFrame& Frame);
+	void ReadFrame(FFrame& Frame);
+
+	bool bInitialized = false;
+
+	std::array<FFrame, GPU_PROFILER_LATENCY + 1> Frames;
+	size_t FrameIndex = 0;
+	// Ranges begun and not ended yet.
+	std::vector<size_t> OpenRanges;
+
+	std::vector<FTimer> Timers;
+	std::unordered_map<std::string, size_t> TimerIndices;
+};
+
+// Measures GPU time of the enclosing scope.
+class FGpuScope
+{
+public:
+	FGpuScope(FGpuProfiler& inProfiler, const std::string& Name)
+		:Profiler(inProfiler)
+	{
+		Profiler.Begin(Name);
+	}
+	~FGpuScope()
+	{
+		Profiler.End();
+	}
+
+	FGpuScope(const FGpuScope&) = delete;
+	FGpuScope& operator=(const FGpuScope&) = delete;
+
+private:
+	FGpuProfiler& Profiler;
+};
@@ -0,0 +1,56 @@
+#include "DrawList.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+uint64_t FDrawList::MakeKey(EDrawPass Pass, uint32_t Program, uint32_t Material, float Depth)
+{
+	// Bits of a positive float grow with its value, the top 24 keep the exponent and 15 bits of mantissa.
+	Depth = std::max(Depth, 0.f);
+	uint32_t DepthBits = 0;
+	memcpy(&DepthBits, &Depth, sizeof(Depth));
+
+	return (uint64_t(Pass) & 0xFF) << 56 |
+		(uint64_t(Program) & 0xFFFF) << 40 |
+		(uint64_t(Material) & 0xFFFF) << 24 |
+		uint64_t(DepthBits >> 8);
+}
+
+void FDrawList::Sort()
+{
+	if (Items.size() < 2)
+	{
+		return;
+	}
+
+	Scratch.resize(Items.size());
+
+	for (int Shift = 0; Shift < 64; Shift += 8)
+	{
+		std::array<size_t, 256> Offsets = {};
+		for (const FDrawItem& Item : Items)
+		{
+			++Offsets[(Item.SortKey >> Shift) & 0xFF];
+		}
+
+		if (Offsets[(Items[0].SortKey >> Shift) & 0xFF] == Items.size())
+		{
+			continue;
+		}
+
+		size_t Offset = 0;
+		for (size_t& Count : Offsets)
+		{
+			const size_t Digits = Count;
+			Count = Offset;
+			Offset += Digits;
+		}
+
+		for (const FDrawItem& Item : Items)
+		{
+			Scratch[Offsets[(Item.SortKey >> Shift) & 0xFF]++] = Item;
+		}
+		Items.swap(Scratch);
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class FShader;
+
+// Passes are drawn in this order, the pass is the most significant part of the sort key.
+enum class EDrawPass
+{
+	// Depth only, so the opaque pass shades every pixel once.
+	EDepthPrepass,
+	EOpaque,
+};
+
+// Sphere or instanced material grid drawn in a frame.
+struct FDrawItem
+{
+	EDrawPass Pass = EDrawPass::EOpaque;
+	FShader* Shader = nullptr;
+	// Draws the grid of material spheres in one instanced draw call instead of a single sphere.
+	bool bInstanced = false;
+	float Offset = 0.f;
+	uint64_t SortKey = 0;
+};
+
+// Draws of a frame, submitted in the order of their sort keys.
+class FDrawList
+{
+public:
+
+	// Bits from the most significant : pass (8), program (16), material (16), view depth (24).
+	// Draws sharing a program and textures end up next to each other, front to back within them for early depth rejection.
+	static uint64_t MakeKey(EDrawPass Pass, uint32_t Program, uint32_t Material, float Depth);
+
+	void Clear() { Items.clear(); };
+	void Add(const FDrawItem& Item) { Items.push_back(Item); };
+
+	// Stable LSD radix sort by SortKey, one byte per pass. Passes where all the keys share the byte are skipped.
+	void Sort();
+
+	const std::vector<FDrawItem>& GetItems() const { return Items; };
+	std::vector<FDrawItem>::const_iterator begin() const { return Items.begin(); };
+	std::vector<FDrawItem>::const_iterator end() const { return Items.end(); };
+
+private:
+
+	std::vector<FDrawItem> Items;
+	// Kept between frames, so sorting does not allocate.
+	std::vector<FDrawItem> Scratch;
+};
@@ -0,0 +1,18 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+float FDynamicResolution::Update(float GpuTime, float TargetTime)
+{
+	if (GpuTime <= 0.f || TargetTime <= 0.f || std::abs(GpuTime - TargetTime) < TargetTime * DYNAMIC_RESOLUTION_TOLERANCE)
+	{
+		return Scale;
+	}
+
+	// Shading cost follows the pixel count, the square of the scale.
+	const float Desired = Scale * std::sqrt(TargetTime / GpuTime);
+	Scale += (Desired - Scale) * DYNAMIC_RESOLUTION_RATE;
+	Scale = std::max(DYNAMIC_RESOLUTION_MIN, std::min(Scale, DYNAMIC_RESOLUTION_MAX));
+	return Scale;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+// Scene resolution range relative to the window.
+#define DYNAMIC_RESOLUTION_MIN 0.5f
+#define DYNAMIC_RESOLUTION_MAX 1.f
+// Share of the correction applied per frame. GPU times arrive GPU_PROFILER_LATENCY frames late,
+// so full steps would overshoot and oscillate.
+#define DYNAMIC_RESOLUTION_RATE 0.1f
+// Relative error ignored, keeps the scale still when the frame time only jitters.
+#define DYNAMIC_RESOLUTION_TOLERANCE 0.05f
+
+// Scales scene resolution, so the measured GPU frame time approaches the target.
+class FDynamicResolution
+{
+public:
+
+	// GpuTime and TargetTime in milliseconds, GpuTime zero when nothing was measured yet. Returns the new scale.
+	float Update(float GpuTime, float TargetTime);
+	void Reset() { Scale = DYNAMIC_RESOLUTION_MAX; };
+
+	// Of width and height.
+	float GetScale() const { return Scale; };
+
+private:
+
+	float Scale = DYNAMIC_RESOLUTION_MAX;
+};
@@ -0,0 +1,105 @@
+#include "FramePacket.h"
+
+FGuiDrawData::~FGuiDrawData()
+{
+	Clear();
+}
+
+void FGuiDrawData::Copy(const ImDrawData* Source)
+{
+	Clear();
+	if (!Source || !Source->Valid)
+	{
+		return;
+	}
+
+	// Vertex and index buffers are reused by ImGui next frame, so every list is cloned.
+	for (int i = 0; i < Source->CmdListsCount; ++i)
+	{
+		Lists.push_back(Source->CmdLists[i]->CloneOutput());
+	}
+
+	Data = *Source;
+	Data.CmdLists = Lists.data();
+}
+
+void FGuiDrawData::Clear()
+{
+	for (ImDrawList* List : Lists)
+	{
+		IM_DELETE(List);
+	}
+	Lists.clear();
+	Data.Clear();
+}
+
+FFrameQueue::FFrameQueue(size_t inCapacity)
+	:Capacity(inCapacity)
+{
+}
+
+std::unique_ptr<FFramePacket> FFrameQueue::Acquire()
+{
+	std::unique_ptr<FFramePacket> Packet;
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		if (!Released.empty())
+		{
+			Packet = std::move(Released.back());
+			Released.pop_back();
+		}
+	}
+
+	if (!Packet)
+	{
+		return std::make_unique<FFramePacket>();
+	}
+
+	Packet->LightPositions.clear();
+	Packet->Draws.Clear();
+	Packet->Gui.Clear();
+	return Packet;
+}
+
+void FFrameQueue::Release(std::unique_ptr<FFramePacket> Packet)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	Released.push_back(std::move(Packet));
+}
+
+bool FFrameQueue::Push(std::unique_ptr<FFramePacket> Packet)
+{
+	std::unique_lock<std::mutex> Lock(Mutex);
+	NotFull.wait(Lock, [this]() { return bStopped || Packets.size() < Capacity; });
+	if (bStopped)
+	{
+		return false;
+	}
+
+	Packets.push_back(std::move(Packet));
+	NotEmpty.notify_one();
+	return true;
+}
+
+bool FFrameQueue::Pop(std::unique_ptr<FFramePacket>& Packet)
+{
+	std::unique_lock<std::mutex> Lock(Mutex);
+	NotEmpty.wait(Lock, [this]() { return bStopped || !Packets.empty(); });
+	if (Packets.empty())
+	{
+		return false;
+	}
+
+	Packet = std::move(Packets.front());
+	Packets.pop_front();
+	NotFull.notify_one();
+	return true;
+}
+
+void FFrameQueue::Stop()
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	bStopped = true;
+	NotFull.notify_all();
+	NotEmpty.notify_all();
+}
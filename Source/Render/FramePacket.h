@@ -0,0 +1,106 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "imgui.h"
+
+#include "DrawList.h"
+
+// Number of built frames waiting for the render thread. Main thread runs at most this many frames ahead
+// of the frame being drawn, so one keeps input latency low and still overlaps building with rendering.
+#define FRAME_QUEUE_DEPTH 1
+
+// Copy of ImGui draw lists, the next GUI frame is built while this one is rendered.
+class FGuiDrawData
+{
+public:
+	FGuiDrawData() = default;
+	~FGuiDrawData();
+
+	FGuiDrawData(const FGuiDrawData&) = delete;
+	FGuiDrawData& operator=(const FGuiDrawData&) = delete;
+
+	void Copy(const ImDrawData* Source);
+	void Clear();
+
+	// Null if nothing was copied.
+	ImDrawData* Get() { return Data.Valid ? &Data : nullptr; };
+
+private:
+	ImDrawData Data;
+	std::vector<ImDrawList*> Lists;
+};
+
+// Everything the render thread needs to draw a frame, built on the main thread from input and GUI state.
+// Render thread never reads the settings of Application the GUI edits, only their snapshot here.
+struct FFramePacket
+{
+	glm::mat4 View = glm::mat4(1.f);
+	glm::vec3 CameraPosition = glm::vec3(0.f);
+
+	std::vector<glm::vec3> LightPositions;
+
+	float Metallic = 0.f;
+	float Roughness = 0.f;
+	glm::vec3 Albedo = glm::vec3(0.f);
+
+	// Sorted.
+	FDrawList Draws;
+	// Draws start with a depth pre-pass, the opaque pass tests depth for equality.
+	bool bDepthPrepass = false;
+
+	// Scene is drawn at a scale chosen to reach the target GPU frame time in milliseconds, GUI at native resolution.
+	bool bDynamicResolution = false;
+	float TargetFrameTime = 0.f;
+
+	// Settings applied by the render thread, which owns the GL objects they change.
+	int SphereSegments = 0;
+	bool bVirtualTexturing = false;
+	bool bPrewarmShaders = false;
+	// Feature defines of the lit shaders.
+	bool bFresnelSchlick = false;
+	bool bLightsUniformBuffer = true;
+
+	int FramebufferWidth = 0;
+	int FramebufferHeight = 0;
+
+	// Empty in headless modes.
+	FGuiDrawData Gui;
+};
+
+// Bounded queue of frames from the main thread to the render thread.
+// Push blocks while the queue is full, so the main thread never gets more than Capacity frames ahead.
+// Drawn packets come back for reuse, so ImGui memory is allocated and freed on the main thread only.
+class FFrameQueue
+{
+public:
+	explicit FFrameQueue(size_t inCapacity = FRAME_QUEUE_DEPTH);
+
+	// Main thread : packet drawn before, or a new one.
+	std::unique_ptr<FFramePacket> Acquire();
+	// Render thread : hands the drawn packet back.
+	void Release(std::unique_ptr<FFramePacket> Packet);
+
+	// Returns false once stopped, the packet is dropped.
+	bool Push(std::unique_ptr<FFramePacket> Packet);
+	// Waits for the next packet, returns false once stopped and empty.
+	bool Pop(std::unique_ptr<FFramePacket>& Packet);
+
+	// Wakes both sides, the render thread still drains the packets already queued.
+	void Stop();
+
+private:
+	size_t Capacity;
+	bool bStopped = false;
+
+	std::mutex Mutex;
+	std::condition_variable NotFull;
+	std::condition_variable NotEmpty;
+	std::deque<std::unique_ptr<FFramePacket>> Packets;
+	std::vector<std::unique_ptr<FFramePacket>> Released;
+};
@@ -0,0 +1,183 @@
+#include "StateCache.h"
+
+#include <algorithm>
+#include <initializer_list>
+
+namespace
+{
+	// Never a valid name, the first bind after Invalidate always differs.
+	const GLuint Unknown = ~0u;
+}
+
+FStateCache& FStateCache::Get()
+{
+	static FStateCache Instance;
+	return Instance;
+}
+
+FStateCache::FStateCache()
+{
+	Invalidate();
+}
+
+void FStateCache::UseProgram(GLuint inProgram)
+{
+	if (!IsBound(Program, inProgram))
+	{
+		glUseProgram(inProgram);
+	}
+}
+
+void FStateCache::BindVertexArray(GLuint inVertexArray)
+{
+	if (!IsBound(VertexArray, inVertexArray))
+	{
+		glBindVertexArray(inVertexArray);
+	}
+}
+
+void FStateCache::BindTexture(GLuint Unit, GLenum Target, GLuint Texture)
+{
+	GLuint* Cached = FindTexture(Unit, Target);
+	if (Cached && *Cached == Texture)
+	{
+		++Skipped;
+		return;
+	}
+
+	ActiveTexture(Unit);
+	glBindTexture(Target, Texture);
+	++Issued;
+
+	if (Cached)
+	{
+		*Cached = Texture;
+	}
+}
+
+void FStateCache::BindTexture(GLenum Target, GLuint Texture)
+{
+	BindTexture(ActiveUnit == Unknown ? 0 : ActiveUnit, Target, Texture);
+}
+
+void FStateCache::BindBuffer(GLenum Target, GLuint Buffer)
+{
+	GLuint* Cached = FindBuffer(Target);
+	if (!Cached)
+	{
+		glBindBuffer(Target, Buffer);
+		++Issued;
+	}
+	else if (!IsBound(*Cached, Buffer))
+	{
+		glBindBuffer(Target, Buffer);
+	}
+}
+
+void FStateCache::DeleteTextures(GLsizei Count, const GLuint* inTextures)
+{
+	for (GLsizei i = 0; i < Count; ++i)
+	{
+		std::replace(Textures2D.begin(), Textures2D.end(), inTextures[i], 0u);
+		std::replace(TextureArrays.begin(), TextureArrays.end(), inTextures[i], 0u);
+	}
+
+	glDeleteTextures(Count, inTextures);
+}
+
+void FStateCache::DeleteBuffers(GLsizei Count, const GLuint* Buffers)
+{
+	for (GLsizei i = 0; i < Count; ++i)
+	{
+		for (GLuint* Cached : { &ArrayBuffer, &PixelPackBuffer, &PixelUnpackBuffer })
+		{
+			*Cached = *Cached == Buffers[i] ? 0 : *Cached;
+		}
+	}
+
+	glDeleteBuffers(Count, Buffers);
+}
+
+void FStateCache::DeleteVertexArrays(GLsizei Count, const GLuint* VertexArrays)
+{
+	for (GLsizei i = 0; i < Count; ++i)
+	{
+		VertexArray = VertexArray == VertexArrays[i] ? 0 : VertexArray;
+	}
+
+	glDeleteVertexArrays(Count, VertexArrays);
+}
+
+void FStateCache::Invalidate()
+{
+	Program = Unknown;
+	VertexArray = Unknown;
+	ActiveUnit = Unknown;
+	Textures2D.fill(Unknown);
+	TextureArrays.fill(Unknown);
+	ArrayBuffer = Unknown;
+	PixelPackBuffer = Unknown;
+	PixelUnpackBuffer = Unknown;
+}
+
+void FStateCache::BeginFrame()
+{
+	Invalidate();
+
+	LastIssued = Issued;
+	LastSkipped = Skipped;
+	Issued = 0;
+	Skipped = 0;
+}
+
+bool FStateCache::IsBound(GLuint& Cached, GLuint Value)
+{
+	if (Cached == Value)
+	{
+		++Skipped;
+		return true;
+	}
+
+	Cached = Value;
+	++Issued;
+	return false;
+}
+
+void FStateCache::ActiveTexture(GLuint Unit)
+{
+	if (!IsBound(ActiveUnit, Unit))
+	{
+		glActiveTexture(GL_TEXTURE0 + Unit);
+	}
+}
+
+GLuint* FStateCache::FindTexture(GLuint Unit, GLenum Target)
+{
+	if (Unit >= STATE_CACHE_TEXTURE_UNITS)
+	{
+		return nullptr;
+	}
+
+	switch (Target)
+	{
+	case GL_TEXTURE_2D:
+		return &Textures2D[Unit];
+	case GL_TEXTURE_2D_ARRAY:
+		return &TextureArrays[Unit];
+	}
+	return nullptr;
+}
+
+GLuint* FStateCache::FindBuffer(GLenum Target)
+{
+	switch (Target)
+	{
+	case GL_ARRAY_BUFFER:
+		return &ArrayBuffer;
+	case GL_PIXEL_PACK_BUFFER:
+		return &PixelPackBuffer;
+	case GL_PIXEL_UNPACK_BUFFER:
+		return &PixelUnpackBuffer;
+	}
+	return nullptr;
+}
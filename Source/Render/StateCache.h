@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+
+#include <glad/glad.h>
+
+// Texture units whose bindings are tracked, binds to higher units are always issued.
+#define STATE_CACHE_TEXTURE_UNITS 16
+
+// Bindings last issued on the render thread, so binding what is already bound costs no driver call.
+// Programs, vertex arrays, textures and buffers are bound through it. Code binding behind its back,
+// like the ImGui backend restoring its changes, is covered by forgetting everything at frame start.
+class FStateCache
+{
+public:
+
+	static FStateCache& Get();
+
+	void UseProgram(GLuint inProgram);
+	void BindVertexArray(GLuint inVertexArray);
+	// Switches the active unit only if the binding changes.
+	void BindTexture(GLuint Unit, GLenum Target, GLuint Texture);
+	// Binds to the active unit, for uploads.
+	void BindTexture(GLenum Target, GLuint Texture);
+	// Element array binding is part of the vertex array, so it is always issued.
+	void BindBuffer(GLenum Target, GLuint Buffer);
+
+	// Bindings of deleted names revert to zero, the names may be reused by new objects.
+	void DeleteTextures(GLsizei Count, const GLuint* inTextures);
+	void DeleteBuffers(GLsizei Count, const GLuint* Buffers);
+	void DeleteVertexArrays(GLsizei Count, const GLuint* VertexArrays);
+
+	// Forgets all bindings, the next bind of everything is issued.
+	void Invalidate();
+
+	// Forgets bindings changed since the last frame and starts counting calls of a new one.
+	void BeginFrame();
+	// Bind calls of the last finished frame.
+	int GetIssuedCalls() const { return LastIssued; };
+	int GetSkippedCalls() const { return LastSkipped; };
+
+private:
+
+	FStateCache();
+
+	// Updates Cached and returns false if the call has to be issued.
+	bool IsBound(GLuint& Cached, GLuint Value);
+	void ActiveTexture(GLuint Unit);
+	// Null for untracked units and targets.
+	GLuint* FindTexture(GLuint Unit, GLenum Target);
+	GLuint* FindBuffer(GLenum Target);
+
+	GLuint Program;
+	GLuint VertexArray;
+	GLuint ActiveUnit;
+	std::array<GLuint, STATE_CACHE_TEXTURE_UNITS> Textures2D;
+	std::array<GLuint, STATE_CACHE_TEXTURE_UNITS> TextureArrays;
+	GLuint ArrayBuffer;
+	GLuint PixelPackBuffer;
+	GLuint PixelUnpackBuffer;
+
+	int Issued = 0;
+	int Skipped = 0;
+	int LastIssued = 0;
+	int LastSkipped = 0;
+};
@@ -0,0 +1,55 @@
+// Blinn-Phong lighting shared by the BlinnPhong and Gouraud shaders.
+// PHONG_REFLECT uses the reflected light direction (Gouraud) instead of the halfway vector.
+// Untextured variants are tuned for direct display output, textured ones for the sRGB framebuffer.
+
+#include "lights.glsl"
+
+#ifdef TEXTURED
+// Shading is linear and encoded on write, intensities are the former display space ones (0.3, 0.2, 0.8)
+// raised to 2.2, so a fully lit sphere looks as bright as before.
+#define SHININESS_SCALE 12.5
+#define DIFFUSE_INTENSITY 0.071
+#define AMBIENT_INTENSITY 0.029
+#define SPECULAR_INTENSITY 0.61
+#else
+#define SHININESS_SCALE 20.
+#define DIFFUSE_INTENSITY 1.45
+#define AMBIENT_INTENSITY 0.83
+#define SPECULAR_INTENSITY 0.8
+#endif
+
+vec3 ShadeBlinnPhong(vec3 N, vec3 WorldPos, vec3 Diffuse, float Roughness)
+{
+    // Transfer of PBR parameters. 
+    float Specular = 1 - Roughness;
+    float Shininess = SHININESS_SCALE / (Roughness * Roughness) - 2.;
+
+    vec3 DiffusePart = vec3(0.);
+    vec3 SpecularPart = vec3(0.);
+
+    vec3 ViewDir = normalize(CameraPos - WorldPos);
+
+    for(int i = 0; i < min(MAX_LIGHTS,LightsNum); ++i) 
+    {
+        vec3 LightDir = normalize(LightPositions[i] - WorldPos);
+        
+        float Diff = max(dot(LightDir, N), 0.0);
+
+#ifdef PHONG_REFLECT
+        vec3 ReflectDir = reflect(-LightDir, N);
+        float Spec = pow(max(dot(ViewDir,ReflectDir), 0.0), Shininess);
+#else
+        vec3 HalfwayDir = normalize(LightDir + ViewDir);  
+        float Spec = pow(max(dot(N, HalfwayDir), 0.0), Shininess);
+#endif
+
+        float Attenuation = 300. * GetAttenuation(LightPositions[i], WorldPos);    
+    
+        DiffusePart  += vec3(DIFFUSE_INTENSITY) * Diff * Diffuse * Attenuation;
+        SpecularPart += vec3(SPECULAR_INTENSITY) * Spec * Specular * Attenuation; 
+    }
+    
+    vec3 Ambient = vec3(AMBIENT_INTENSITY) * Diffuse;
+
+    return Ambient + DiffusePart + SpecularPart;
+}
\ No newline at end of file
@@ -1,57 +1,23 @@
-#version 330 core
+// Cook-Torrance BRDF shared by the PBR shaders.
 
-out vec4 FragColor;
-in vec2 TexCoords;
-in vec3 WorldPos;
-in vec3 Normal;
-
-uniform sampler2D AlbedoMap;
-uniform sampler2D NormalMap;
-uniform sampler2D MetallicMap;
-uniform sampler2D RoughnessMap;
-
-#define MAX_LIGHTS 992
-
-uniform int LightsNum;
-uniform vec3 LightPositions[MAX_LIGHTS];
-
-uniform vec3 CameraPos;
-
-
-vec3 GetNormalFromMap()
-{
-    vec3 TangentNormal = texture(NormalMap, TexCoords).xyz * 2.0 - 1.0;
-
-    vec3 Q1  = dFdx(WorldPos);
-    vec3 Q2  = dFdy(WorldPos);
-    vec2 St1 = dFdx(TexCoords);
-    vec2 St2 = dFdy(TexCoords);
-
-    vec3 N   = normalize(Normal);
-    vec3 T  = normalize(Q1*St2.t - Q2*St1.t);
-    vec3 B  = -normalize(cross(N, T));
-    mat3 TBN = mat3(T, B, N);
-
-    return normalize(TBN * TangentNormal);
-}
+#include "lights.glsl"
 
 const float PI = 3.14159265359;
 
 float DistributionGGX(vec3 N, vec3 H, float Roughness)
 {
     float a = Roughness*Roughness;
-    float A2 = a*a;
+    float a2 = a*a;
     float NdotH = max(dot(N, H), 0.0);
     float NdotH2 = NdotH*NdotH;
 
-    float Nom   = A2;
-    float Denom = (NdotH2 * (A2 - 1.0) + 1.0);
+    float Nom   = a2;
+    float Denom = (NdotH2 * (a2 - 1.0) + 1.0);
     Denom = PI * Denom * Denom;
 
     return Nom / Denom;
 }
 
-
 float GGX(float NdotV, float Roughness)
 {
     float a = Roughness*Roughness;
@@ -73,7 +39,16 @@ float GeometrySmith(vec3 N, vec3 V, vec3 L, float Roughness)
     return Ggx1 * Ggx2;
 }
 
-vec3 FresnelCookTorrence(float CosTheta, vec3 F0)
+// Fresnel model is injected by the application.
+// FRESNEL_SCHLICK - Schlick's approximation, cheaper and close to the full one for dielectrics.
+// FRESNEL_COOK_TORRANCE - full Cook-Torrance fresnel.
+#ifdef FRESNEL_SCHLICK
+vec3 Fresnel(float CosTheta, vec3 F0)
+{
+    return F0 + (1.0 - F0) * pow(clamp(1.0 - CosTheta, 0.0, 1.0), 5.0);
+}
+#else
+vec3 Fresnel(float CosTheta, vec3 F0)
 {
     F0 = sqrt(F0);
     vec3 n = (1. + F0) / (1. - F0);
@@ -88,20 +63,16 @@ vec3 FresnelCookTorrence(float CosTheta, vec3 F0)
 
     return 0.5 * expr1 * (1. + expr2);
 }
+#endif
 
-void main()
-{		
-    vec3 Albedo     = pow(texture(AlbedoMap, TexCoords).rgb, vec3(2.2));
-    float Metallic  = texture(MetallicMap, TexCoords).r;
-    float Roughness = texture(RoughnessMap, TexCoords).r;
-
-    vec3 N = GetNormalFromMap();
+// Reflectance equation over all the lights, returns tonemapped linear color.
+vec3 ShadePBR(vec3 N, vec3 WorldPos, vec3 Albedo, float Metallic, float Roughness)
+{
     vec3 V = normalize(CameraPos - WorldPos);
 
     vec3 F0 = vec3(0.04); 
     F0 = mix(F0, Albedo, Metallic);
 
-    // Reflectance equation
     vec3 Lo = vec3(0.0);
     for(int i = 0; i < min(MAX_LIGHTS,LightsNum); ++i) 
     {
@@ -111,7 +82,7 @@ void main()
         // Specular part of BRDF
         float D = DistributionGGX(N, H, Roughness);   
         float G   = GeometrySmith(N, V, L, Roughness);      
-        vec3 F    = FresnelCookTorrence(clamp(dot(H, V), 0.0, 1.0), F0);
+        vec3 F    = Fresnel(clamp(dot(H, V), 0.0, 1.0), F0);
            
         vec3 Numerator    = D * G * F; 
         float Denominator = 4 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0);
@@ -130,9 +101,7 @@ void main()
         // Cook-Torrance BRDF
         vec3 BRDF = Diffuse  + Specular; 
 
-        float Distance = length(LightPositions[i] - WorldPos);
-        float Attenuation = 1.0 / (Distance * Distance);
-        vec3 Radiance = vec3(300.0) * Attenuation;
+        vec3 Radiance = vec3(300.0) * GetAttenuation(LightPositions[i], WorldPos);
 
         float NdotL = max(dot(N, L), 0.0);        
 
@@ -145,9 +114,7 @@ void main()
 
     // HDR tonemapping
     Color = Color / (Color + vec3(1.0));
+    // Gamma correction is done by the sRGB framebuffer.
 
-    // Gamma correct
-    Color = pow(Color, vec3(1.0/2.2)); 
-
-    FragColor = vec4(Color, 1.0);
+    return Color;
 }
\ No newline at end of file
@@ -0,0 +1,26 @@
+// Point lights, MAX_LIGHTS and the backend are injected by the application.
+// LIGHTS_UNIFORM_BUFFER - positions in a uniform buffer uploaded once per frame and shared by every program.
+// LIGHTS_UNIFORMS - positions set as uniforms of every program before it draws.
+
+#ifndef MAX_LIGHTS
+#define MAX_LIGHTS 992
+#endif
+
+uniform int LightsNum;
+#ifdef LIGHTS_UNIFORM_BUFFER
+// std140 pads every element to vec4, MAX_LIGHTS of them fit the 16 KB minimum block size.
+layout(std140) uniform Lights
+{
+    vec3 LightPositions[MAX_LIGHTS];
+};
+#else
+uniform vec3 LightPositions[MAX_LIGHTS];
+#endif
+
+uniform vec3 CameraPos;
+
+float GetAttenuation(vec3 LightPosition, vec3 WorldPos)
+{
+    float Distance = length(LightPosition - WorldPos);
+    return 1.0 / (Distance * Distance);
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+// Material parameters : uniforms, textures, texture arrays or virtual textures.
+// SAMPLE_MAP(Map, Index, UV) samples map of textured materials, Index is Albedo, Normal, Metallic, Roughness.
+
+#if defined(TEXTURE_ARRAY)
+
+// Layer per material.
+flat in float Layer;
+
+uniform sampler2DArray AlbedoMap;
+uniform sampler2DArray NormalMap;
+uniform sampler2DArray MetallicMap;
+uniform sampler2DArray RoughnessMap;
+
+#define SAMPLE_MAP(Map, Index, UV) texture(Map, vec3(UV, Layer))
+
+#elif defined(TEXTURED)
+
+uniform sampler2D AlbedoMap;
+uniform sampler2D NormalMap;
+uniform sampler2D MetallicMap;
+uniform sampler2D RoughnessMap;
+
+#ifdef VIRTUAL_TEXTURING
+#include "virtual_texture.glsl"
+#define SAMPLE_MAP(Map, Index, UV) SampleVirtual(PageTables[Index], PhysicalPages[Index], VirtualSizes[Index], UV)
+#else
+#define SAMPLE_MAP(Map, Index, UV) texture(Map, UV)
+#endif
+
+#else
+
+uniform vec3 Albedo;
+uniform float Metallic;
+uniform float Roughness;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,23 @@
+// World space normal from the normal map, requires SAMPLE_MAP from material.glsl.
+// VERTEX_TANGENTS uses the interpolated tangent frame instead of screen space derivatives.
+
+vec3 GetNormalFromMap()
+{
+    vec3 TangentNormal = SAMPLE_MAP(NormalMap, 1, TexCoords).xyz * 2.0 - 1.0;
+
+#ifdef VERTEX_TANGENTS
+    mat3 TBN = mat3(Tangent, Bitangent, Normal);
+#else
+    vec3 Q1  = dFdx(WorldPos);
+    vec3 Q2  = dFdy(WorldPos);
+    vec2 St1 = dFdx(TexCoords);
+    vec2 St2 = dFdy(TexCoords);
+
+    vec3 N   = normalize(Normal);
+    vec3 T  = normalize(Q1*St2.t - Q2*St1.t);
+    vec3 B  = -normalize(cross(N, T));
+    mat3 TBN = mat3(T, B, N);
+#endif
+
+    return normalize(TBN * TangentNormal);
+}
\ No newline at end of file
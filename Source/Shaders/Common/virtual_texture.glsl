@@ -0,0 +1,33 @@
+// Virtual texturing, see Texture/VirtualTexture.h.
+#define VT_PAGE_SIZE 128.
+#define VT_PAGE_BORDER 4.
+
+// Albedo, Normal, Metallic, Roughness.
+uniform sampler2D PageTables[4];
+uniform sampler2D PhysicalPages[4];
+// Width, height and mip count of virtual texture.
+uniform vec3 VirtualSizes[4];
+
+vec4 SampleVirtual(sampler2D PageTable, sampler2D PhysicalPage, vec3 VirtualSize, vec2 UV)
+{
+#ifdef SHADER_VERTEX
+    // No derivatives in vertex shader, finest resident page is used.
+    int Mip = 0;
+#else
+    vec2 Dx = dFdx(UV * VirtualSize.xy);
+    vec2 Dy = dFdy(UV * VirtualSize.xy);
+    float Lod = 0.5 * log2(max(dot(Dx, Dx), dot(Dy, Dy)));
+    int Mip = int(clamp(floor(Lod), 0., VirtualSize.z - 1.));
+#endif
+
+    UV = fract(UV);
+    ivec2 Pages = textureSize(PageTable, Mip);
+    vec3 Entry = floor(texelFetch(PageTable, min(ivec2(UV * vec2(Pages)), Pages - 1), Mip).rgb * 255. + 0.5);
+
+    // Entry points to the finest resident page covering UV, possibly from coarser mip.
+    vec2 MipSize = max(floor(VirtualSize.xy / exp2(Entry.b)), vec2(1.));
+    vec2 InPage = mod(UV * MipSize, VT_PAGE_SIZE);
+    vec2 AtlasTexel = Entry.rg * (VT_PAGE_SIZE + 2. * VT_PAGE_BORDER) + VT_PAGE_BORDER + InPage;
+
+    return textureLod(PhysicalPage, AtlasTexel / vec2(textureSize(PhysicalPage, 0)), 0.);
+}
\ No newline at end of file
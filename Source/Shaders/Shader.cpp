@@ -25,58 +25,346 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 #include "Shader.h"
 
+#include <GLFW/glfw3.h>
+
+#define PROGRAM_CACHE_DIR "ShaderCache"
+/* Tools/optimize_shaders.py reads dumped sources and writes optimised ones with the same name */
+#define PREPROCESSED_SHADER_DIR PROGRAM_CACHE_DIR "/Preprocessed"
+#define OPTIMIZED_SHADER_DIR PROGRAM_CACHE_DIR "/Optimized"
+/* startup times of the last cold and warm start */
+#define LOAD_TIMES_PATH PROGRAM_CACHE_DIR "/LoadTimes.txt"
+
+/* KHR_parallel_shader_compile, not part of the core loader */
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void ( APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC )( GLuint count );
+
+bool FShader::bParallelCompile = false;
+bool FShader::bDumpPreprocessed = false;
+std::unordered_map<std::string, FShader::FSourceFile> FShader::SourceCache;
+
+
+namespace
+{
+	const unsigned long long hash_basis = 14695981039346656037ull;
 
-FShader::FShader(const char* inName, const char* inVertexPath, const char* inFragPath)
+	/* FNV-1a */
+	void HashBytes( unsigned long long& hash, const void* data, size_t size )
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for( size_t i = 0; i < size; ++i )
+		{
+			hash ^= bytes[ i ];
+			hash *= 1099511628211ull;
+		}
+	}
+
+	/* strings are terminated by a separator so "ab" + "c" differs from "a" + "bc" */
+	void HashString( unsigned long long& hash, const char* str )
+	{
+		if( str )
+			HashBytes( hash, str, strlen( str ) );
+		hash ^= 0xff;
+		hash *= 1099511628211ull;
+	}
+
+	void MakeDirectory( const char* path )
+	{
+#ifdef _WIN32
+		_mkdir( path );
+#else
+		mkdir( path, 0755 );
+#endif
+	}
+
+	/* program binaries are core since GL 4.1, ARB_get_program_binary has the same entry points */
+	bool LoadProgramBinaryFunctions()
+	{
+		if( GLAD_GL_VERSION_4_1 )
+			return true;
+		if( !glfwExtensionSupported( "GL_ARB_get_program_binary" ) )
+			return false;
+
+		/* loader fills in core functions of the context version only */
+		glad_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)glfwGetProcAddress( "glGetProgramBinary" );
+		glad_glProgramBinary = (PFNGLPROGRAMBINARYPROC)glfwGetProcAddress( "glProgramBinary" );
+		glad_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)glfwGetProcAddress( "glProgramParameteri" );
+		return glad_glGetProgramBinary && glad_glProgramBinary && glad_glProgramParameteri;
+	}
+}
+
+FShader::FShader(const char* inName, const char* inVertexPath, const char* inFragPath, bool inLinearOutput, const std::vector<std::string>& inDefines)
 	:Name(inName),
 	VertexPath(inVertexPath),
-	FragmentPath(inFragPath)
+	FragmentPath(inFragPath),
+	bLinearOutput(inLinearOutput),
+	Defines(inDefines)
 {
-
+	/* kept sorted, so the same define set gives the same sources and hash in any order */
+	std::sort( Defines.begin(), Defines.end() );
 }
 
 void FShader::Init()
 {
-	ID = LoadShaders(VertexPath, FragmentPath, NULL);
+	if( !bSubmitted )
+		Submit();
+	if( !bReady )
+		Finish();
+
+	FStateCache::Get().UseProgram( ID );
+}
+
+void FShader::Submit()
+{
+	bSubmitted = true;
+	bReady = false;
+
+	/* permutation compiled before, e.g. a feature toggled back */
+	auto permutation = Permutations.find( GetPermutationHash() );
+	if( permutation != Permutations.end() )
+	{
+		ID = permutation->second;
+		bReady = true;
+		return;
+	}
+
+	/* reload in flight compiles this define set from the current sources already,
+	* the other permutations are from the old ones */
+	if( ReloadID != 0 )
+	{
+		DeletePermutations();
+		ID = ReloadID;
+		ReloadID = 0;
+		Build = std::move( ReloadBuild );
+		ReloadBuild = FProgramBuild();
+		return;
+	}
+
+	ID = LoadShaders(Build, VertexPath, FragmentPath, NULL);
+}
+
+void FShader::Release()
+{
+	/* unfinished programs are not among the permutations yet */
+	if( !bReady )
+		CancelBuild( ID, Build );
+	CancelBuild( ReloadID, ReloadBuild );
+	DeletePermutations();
+
+	ID = 0;
+	bSubmitted = false;
+	bReady = false;
+}
+
+void FShader::CancelBuild( GLuint& program, FProgramBuild& build )
+{
+	for( const FPendingShader& pending : build.PendingShaders )
+		glDeleteShader( pending.Shader );
+	if( program != 0 )
+		glDeleteProgram( program );
+
+	program = 0;
+	build = FProgramBuild();
+}
+
+void FShader::DeletePermutations()
+{
+	for( const auto& permutation : Permutations )
+		glDeleteProgram( permutation.second );
+	Permutations.clear();
+}
+
+void FShader::Reload()
+{
+	/* reload in flight was started from older sources */
+	CancelBuild( ReloadID, ReloadBuild );
+
+	/* nothing is drawn with a program which is not ready, so the
+	* new sources are compiled as the program itself */
+	if( !bReady )
+	{
+		DeletePermutations();
+		if( bSubmitted )
+		{
+			CancelBuild( ID, Build );
+			Submit();
+		}
+		else
+			ID = 0;
+		return;
+	}
+
+	/* compiled next to the current program, which is used until the new one links */
+	ReloadID = LoadShaders( ReloadBuild, VertexPath, FragmentPath, NULL );
+}
+
+bool FShader::PollReload()
+{
+	if( ReloadID == 0 )
+		return false;
+
+	if( bParallelCompile )
+	{
+		GLint completed = GL_FALSE;
+		glGetProgramiv( ReloadID, GL_COMPLETION_STATUS_KHR, &completed );
+		if( completed == GL_FALSE )
+			return false;
+	}
+
+	GLuint program = ReloadID;
+	ReloadID = 0;
+
+	const bool linked = FinishProgram( program, ReloadBuild );
+	ReloadBuild = FProgramBuild();
+	if( !linked )
+	{
+		fprintf( stderr, "pollReload(): Keeping previous %s program\n", Name.c_str() );
+		glDeleteProgram( program );
+		return false;
+	}
+
+	/* other permutations were built from the old sources */
+	DeletePermutations();
+
+	ID = program;
+	Permutations[ GetPermutationHash() ] = ID;
+	return true;
+}
+
+bool FShader::DependsOn( const std::string& file_path ) const
+{
+	return std::find( SourceFiles.begin(), SourceFiles.end(), file_path ) != SourceFiles.end();
+}
+
+bool FShader::HasDefine( const std::string& define ) const
+{
+	return std::find( Defines.begin(), Defines.end(), define ) != Defines.end();
+}
+
+void FShader::SetDefine( const std::string& define, bool enabled )
+{
+	if( HasDefine( define ) == enabled )
+		return;
+
+	/* program being compiled is kept under the define set it was submitted with */
+	if( bSubmitted && !bReady )
+		Finish();
+
+	if( enabled )
+		Defines.insert( std::lower_bound( Defines.begin(), Defines.end(), define ), define );
+	else
+		Defines.erase( std::find( Defines.begin(), Defines.end(), define ) );
+
+	/* reload compiles the new define set instead, the next Submit() takes it over if
+	* the permutation was not compiled before */
+	if( ReloadID != 0 )
+	{
+		CancelBuild( ReloadID, ReloadBuild );
+		ReloadID = LoadShaders( ReloadBuild, VertexPath, FragmentPath, NULL );
+	}
+
+	/* compiled on the next Submit() or Init(), a permutation compiled before is picked up there */
+	if( bSubmitted )
+	{
+		bSubmitted = false;
+		bReady = false;
+	}
+}
+
+unsigned long long FShader::GetPermutationHash() const
+{
+	/* defines are sorted, so the hash does not depend on the order they were set in */
+	unsigned long long hash = hash_basis;
+	for( const std::string& define : Defines )
+		HashString( hash, define.c_str() );
+	return hash;
+}
+
+bool FShader::Poll()
+{
+	if( bReady )
+		return true;
+	if( !bSubmitted )
+		return false;
 
-	Use();
+	/* without the extension querying the status just blocks until the driver is done */
+	if( bParallelCompile && ID != 0 )
+	{
+		GLint completed = GL_FALSE;
+		glGetProgramiv( ID, GL_COMPLETION_STATUS_KHR, &completed );
+		if( completed == GL_FALSE )
+			return false;
+	}
+
+	Finish();
+	return true;
 }
 
-void FShader::ShaderAttachFromFile( GLuint program, GLenum type, const char* file_path )
+bool FShader::EnableParallelCompile()
+{
+	bParallelCompile = false;
+	if( !glfwExtensionSupported( "GL_KHR_parallel_shader_compile" ) )
+		return false;
+
+	PFNGLMAXSHADERCOMPILERTHREADSKHRPROC max_threads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress( "glMaxShaderCompilerThreadsKHR" );
+	if( !max_threads )
+		return false;
+
+	/* 0xFFFFFFFF lets the driver pick the number of threads */
+	max_threads( 0xFFFFFFFF );
+	bParallelCompile = true;
+	return true;
+}
+
+void FShader::ShaderAttachFromSource( GLuint program, GLenum type, const std::string& source, const char* file_path, FProgramBuild& build )
 {
 	/* compile the shader */
-	GLuint shader = ShaderCompileFromFile( type, file_path );
+	GLuint shader = ShaderCompileFromSource( type, source );
 	if( shader != 0 )
 	{
         /* attach the shader to the program */
 		glAttachShader( program, shader );
 
-		/* delete the shader - it won't actually be
-		* destroyed until the program that it's attached
-		* to has been destroyed */
-		glDeleteShader( shader );
+		/* keep the shader until the program is finished to read its log */
+		build.PendingShaders.push_back( { shader, file_path } );
 	}
 }
 
-GLuint FShader::ShaderCompileFromFile( GLenum type, const char* file_path )
+GLuint FShader::ShaderCompileFromSource( GLenum type, const std::string& source )
 {
-	char* source;
 	GLuint shader;
-	GLint length, result;
-
-	/* get shader source */
-	source = ShaderLoadSource( file_path );
-	if( !source )
-		return 0;
+	GLint length;
+	const char* text = source.c_str();
 
-	/* create shader object, set the source, and compile */
+	/* create shader object, set the source, and compile -
+	* the status is checked once the program is linked, so
+	* the driver can compile all the programs in parallel */
 	shader = glCreateShader( type );
-	length = static_cast<GLint>(strlen( source ));
-	glShaderSource( shader, 1, (const char**)&source, &length );
+	length = static_cast<GLint>(source.size());
+	glShaderSource( shader, 1, &text, &length );
 	glCompileShader( shader );
-	free( source );
+
+	return shader;
+}
+
+bool FShader::ShaderCheckCompile( GLuint shader, const char* file_path )
+{
+	GLint length, result;
 
 	/* make sure the compilation was successful */
 	glGetShaderiv( shader, GL_COMPILE_STATUS, &result );
@@ -89,93 +377,379 @@ GLuint FShader::ShaderCompileFromFile( GLenum type, const char* file_path )
 		log = (char*)malloc( length );
 		glGetShaderInfoLog( shader, length, &result, log );
 
-		/* print an error message and the info log */
+		/* print an error message and the info log, source string numbers index included files */
 		fprintf( stderr, "shaderCompileFromFile(): Unable to compile %s: %s\n", file_path, log );
 		free( log );
-
-		glDeleteShader( shader );
-		return 0;
+		return false;
 	}
 
-	return shader;
+	return true;
 }
 
-char* FShader::ShaderLoadSource( const char* file_path )
+bool FShader::ShaderLoadSource( const std::string& file_path, FShaderSourceView& view )
 {
-	const size_t blockSize = 512;
-	FILE* fp;
-	char buf[ 512 ];
-	char* source = NULL;
-	size_t tmp, sourceLength = 0;
-
-	/* open file */
-	fopen_s( &fp, file_path, "r" );
-	if( !fp )
+	/* every file is read once, views point into the cache */
+	auto cached = SourceCache.find( file_path );
+	if( cached == SourceCache.end() )
 	{
-		fprintf( stderr, "shaderLoadSource(): Unable to open %s for reading\n", file_path );
-		return NULL;
+		std::ifstream file( file_path, std::ios::binary | std::ios::ate );
+		if( !file )
+		{
+			fprintf( stderr, "shaderLoadSource(): Unable to open %s for reading\n", file_path.c_str() );
+			return false;
+		}
+
+		/* read the entire file at once */
+		FSourceFile source;
+		source.Text.resize( (size_t)file.tellg() );
+		file.seekg( 0 );
+		if( !file.read( &source.Text[ 0 ], source.Text.size() ) )
+		{
+			fprintf( stderr, "shaderLoadSource(): Unable to read %s\n", file_path.c_str() );
+			return false;
+		}
+
+		source.Hash = hash_basis;
+		HashBytes( source.Hash, source.Text.data(), source.Text.size() );
+
+		cached = SourceCache.emplace( file_path, std::move( source ) ).first;
 	}
 
-	/* read the entire file into a string */
-	while( (tmp = fread( buf, 1, blockSize, fp )) > 0 )
+	view.Data = cached->second.Text.data();
+	view.Size = cached->second.Text.size();
+	view.Hash = cached->second.Hash;
+	return true;
+}
+
+void FShader::InvalidateSource( const std::string& file_path )
+{
+	SourceCache.erase( file_path );
+}
+
+bool FShader::ShaderResolveIncludes( const std::string& file_path, std::vector<std::string>& included, std::string& source, unsigned long long& hash )
+{
+	const int file_index = (int)included.size();
+	included.push_back( file_path );
+
+	FShaderSourceView text;
+	if( !ShaderLoadSource( file_path, text ) )
+		return false;
+
+	/* output depends only on the contents of the files in inclusion order */
+	HashBytes( hash, &text.Hash, sizeof( text.Hash ) );
+
+	/* includes are relative to the including file */
+	const size_t slash = file_path.find_last_of( "/\\" );
+	const std::string directory = slash == std::string::npos ? std::string() : file_path.substr( 0, slash + 1 );
+
+	const char* text_end = text.Data + text.Size;
+	int line_number = 1;
+	for( const char* line = text.Data; line < text_end; ++line_number )
 	{
-		char* newSource = (char*)malloc( sourceLength + tmp + 1 );
-		if( !newSource )
+		const char* line_end = (const char*)memchr( line, '\n', text_end - line );
+		if( !line_end )
+			line_end = text_end;
+
+		const char* directive = line;
+		while( directive < line_end && ( *directive == ' ' || *directive == '\t' ) )
+			++directive;
+
+		const char* name_begin = NULL;
+		const char* name_end = NULL;
+		if( line_end - directive >= 8 && strncmp( directive, "#include", 8 ) == 0 )
 		{
-			fprintf( stderr, "shaderLoadSource(): malloc failed\n" );
-			if( source )
-				free( source );
-			return NULL;
+			name_begin = (const char*)memchr( directive, '"', line_end - directive );
+			name_end = name_begin ? (const char*)memchr( name_begin + 1, '"', line_end - name_begin - 1 ) : NULL;
 		}
 
-		if( source )
+		if( name_end )
+		{
+			const std::string include_path = directory + std::string( name_begin + 1, name_end );
+
+			/* every file is included once, which also breaks include cycles */
+			if( std::find( included.begin(), included.end(), include_path ) == included.end() )
+			{
+				/* #line keeps compile errors pointing to the right file and line */
+				source += "#line 1 " + std::to_string( included.size() ) + "\n";
+				if( !ShaderResolveIncludes( include_path, included, source, hash ) )
+				{
+					fprintf( stderr, "shaderResolveIncludes(): %s included from %s line %d\n", include_path.c_str(), file_path.c_str(), line_number );
+					return false;
+				}
+			}
+			source += "#line " + std::to_string( line_number + 1 ) + " " + std::to_string( file_index ) + "\n";
+		}
+		else
 		{
-			memcpy( newSource, source, sourceLength );
-			free( source );
+			source.append( line, line_end );
+			source += '\n';
 		}
-		memcpy( newSource + sourceLength, buf, tmp );
 
-		source = newSource;
-		sourceLength += tmp;
+		line = line_end + 1;
+	}
+
+	return true;
+}
+
+bool FShader::ShaderPreprocess( const char* file_path, const char* stage_define, std::string& source, std::vector<std::string>& files, unsigned long long& hash ) const
+{
+	hash = hash_basis;
+	HashString( hash, stage_define );
+	for( const std::string& define : Defines )
+		HashString( hash, define.c_str() );
+
+	std::vector<std::string> included;
+	std::string resolved;
+	if( !ShaderResolveIncludes( file_path, included, resolved, hash ) )
+		return false;
+	files.insert( files.end(), included.begin(), included.end() );
+
+	/* defines go right after #version, which has to be the first directive */
+	size_t version_end = 0;
+	if( resolved.compare( 0, 8, "#version" ) == 0 )
+		version_end = resolved.find( '\n' ) + 1;
+
+	source.assign( resolved, 0, version_end );
+	source += std::string( "#define " ) + stage_define + "\n";
+	for( const std::string& define : Defines )
+		source += "#define " + define + "\n";
+	source += "#line " + std::to_string( version_end > 0 ? 2 : 1 ) + " 0\n";
+	source.append( resolved, version_end, std::string::npos );
+
+	return true;
+}
+
+void FShader::ShaderUseOptimized( std::string& source, unsigned long long& hash, const char* extension )
+{
+	/* artifacts are named by hash of the preprocessed source, so a stale one is never picked */
+	char name[ 32 ];
+	snprintf( name, sizeof( name ), "%016llx.%s", hash, extension );
+
+	if( bDumpPreprocessed )
+	{
+		MakeDirectory( PROGRAM_CACHE_DIR );
+		MakeDirectory( PREPROCESSED_SHADER_DIR );
+
+		std::ofstream dump( std::string( PREPROCESSED_SHADER_DIR "/" ) + name, std::ios::binary | std::ios::trunc );
+		dump << source;
 	}
 
-	/* close the file and null terminate the string */
-	fclose( fp );
-	if( source )
-		source[ sourceLength ] = '\0';
+	std::ifstream file( std::string( OPTIMIZED_SHADER_DIR "/" ) + name, std::ios::binary );
+	if( !file )
+		return;
 
-	return source;
+	std::string optimized( (std::istreambuf_iterator<char>( file )), std::istreambuf_iterator<char>() );
+	if( !optimized.empty() )
+	{
+		source.swap( optimized );
+		HashBytes( hash, source.data(), source.size() );
+	}
 }
 
-int FShader::LoadShaders( const char* vertex_path, const char* fragment_path, const char* geometry_path )
+std::string FShader::ProgramCachePath( const unsigned long long* source_hashes, int count, unsigned long long permutation )
 {
+	GLint formats = 0;
+
+	static const bool supported = LoadProgramBinaryFunctions();
+	if( !supported )
+		return std::string();
+	glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &formats );
+	if( formats == 0 )
+		return std::string();
+
+	/* binaries are valid only for the same sources and driver */
+	unsigned long long hash = hash_basis;
+	HashBytes( hash, source_hashes, count * sizeof( *source_hashes ) );
+
+	HashString( hash, (const char*)glGetString( GL_VENDOR ) );
+	HashString( hash, (const char*)glGetString( GL_RENDERER ) );
+	HashString( hash, (const char*)glGetString( GL_VERSION ) );
+
+	/* permutations of the same shader are told apart by their define set */
+	char name[ 48 ];
+	snprintf( name, sizeof( name ), "%016llx-%016llx.bin", hash, permutation );
+
+	return std::string( PROGRAM_CACHE_DIR "/" ) + name;
+}
+
+void FShader::RecordLoadTime( bool warm, float milliseconds, float& cold_milliseconds, float& warm_milliseconds )
+{
+	cold_milliseconds = 0.f;
+	warm_milliseconds = 0.f;
+
+	/* cold time first, then warm */
+	std::ifstream in( LOAD_TIMES_PATH );
+	if( !( in >> cold_milliseconds >> warm_milliseconds ) )
+	{
+		cold_milliseconds = 0.f;
+		warm_milliseconds = 0.f;
+	}
+	in.close();
+
+	( warm ? warm_milliseconds : cold_milliseconds ) = milliseconds;
+
+	MakeDirectory( PROGRAM_CACHE_DIR );
+	std::ofstream out( LOAD_TIMES_PATH, std::ios::trunc );
+	out << cold_milliseconds << " " << warm_milliseconds << "\n";
+}
+
+GLuint FShader::ProgramLoadBinary( const char* cache_path )
+{
+	std::ifstream file( cache_path, std::ios::binary );
+	if( !file )
+		return 0;
+
+	/* file holds binary format followed by the binary itself */
+	GLenum format = 0;
+	std::vector<char> binary( (std::istreambuf_iterator<char>( file )), std::istreambuf_iterator<char>() );
+	if( binary.size() <= sizeof( format ) )
+		return 0;
+	memcpy( &format, binary.data(), sizeof( format ) );
+
+	GLuint program = glCreateProgram();
+	glProgramBinary( program, format, binary.data() + sizeof( format ), (GLsizei)( binary.size() - sizeof( format ) ) );
+
+	/* driver may reject binaries, e.g. after an update - compile from source then */
 	GLint result;
+	glGetProgramiv( program, GL_LINK_STATUS, &result );
+	if( result == GL_FALSE )
+	{
+		glDeleteProgram( program );
+		return 0;
+	}
+
+	return program;
+}
+
+void FShader::ProgramSaveBinary( GLuint program, const char* cache_path )
+{
+	GLint length = 0;
+	glGetProgramiv( program, GL_PROGRAM_BINARY_LENGTH, &length );
+	if( length <= 0 )
+		return;
+
+	GLenum format = 0;
+	std::vector<char> binary( length );
+	glGetProgramBinary( program, length, &length, &format, binary.data() );
+
+	MakeDirectory( PROGRAM_CACHE_DIR );
+
+	std::ofstream file( cache_path, std::ios::binary | std::ios::trunc );
+	if( !file )
+	{
+		fprintf( stderr, "programSaveBinary(): Unable to open %s for writing\n", cache_path );
+		return;
+	}
+
+	file.write( (const char*)&format, sizeof( format ) );
+	file.write( binary.data(), length );
+}
+
+int FShader::LoadShaders( FProgramBuild& build, const char* vertex_path, const char* fragment_path, const char* geometry_path )
+{
+	build = FProgramBuild();
+
+	/* resolve includes and inject defines of this permutation */
+	std::string sources[ 3 ];
+	unsigned long long hashes[ 3 ] = { 0, 0, 0 };
+	std::vector<std::string> files;
+	if( !ShaderPreprocess( vertex_path, "SHADER_VERTEX", sources[ 0 ], files, hashes[ 0 ] ) ||
+		!ShaderPreprocess( fragment_path, "SHADER_FRAGMENT", sources[ 1 ], files, hashes[ 1 ] ) ||
+		( geometry_path && !ShaderPreprocess( geometry_path, "SHADER_GEOMETRY", sources[ 2 ], files, hashes[ 2 ] ) ) )
+	{
+		return 0;
+	}
+	SourceFiles.swap( files );
+
+	/* offline optimised sources replace the preprocessed ones */
+	ShaderUseOptimized( sources[ 0 ], hashes[ 0 ], "vert" );
+	ShaderUseOptimized( sources[ 1 ], hashes[ 1 ], "frag" );
+	if( geometry_path )
+		ShaderUseOptimized( sources[ 2 ], hashes[ 2 ], "geom" );
+
+	/* try the program binary cache first */
+	build.CachePath = ProgramCachePath( hashes, geometry_path ? 3 : 2, GetPermutationHash() );
+	if( !build.CachePath.empty() )
+	{
+		GLuint cached = ProgramLoadBinary( build.CachePath.c_str() );
+		if( cached != 0 )
+		{
+			build.bLoadedFromCache = true;
+			return cached;
+		}
+	}
+
     /* create program object and attach shaders */
 	GLint g_program = glCreateProgram();
-	ShaderAttachFromFile( g_program, GL_VERTEX_SHADER, vertex_path );
-	if(geometry_path) ShaderAttachFromFile( g_program, GL_GEOMETRY_SHADER, geometry_path );
-	ShaderAttachFromFile( g_program, GL_FRAGMENT_SHADER, fragment_path );
+	if( !build.CachePath.empty() )
+		glProgramParameteri( g_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+	ShaderAttachFromSource( g_program, GL_VERTEX_SHADER, sources[ 0 ], vertex_path, build );
+	if(geometry_path) ShaderAttachFromSource( g_program, GL_GEOMETRY_SHADER, sources[ 2 ], geometry_path, build );
+	ShaderAttachFromSource( g_program, GL_FRAGMENT_SHADER, sources[ 1 ], fragment_path, build );
 
-	/* link the program and make sure that there were no errors */
+	/* link the program, errors are checked in Finish() */
 	glLinkProgram( g_program );
-	glGetProgramiv( g_program, GL_LINK_STATUS, &result );
+	return g_program;
+}
+
+void FShader::Finish()
+{
+	bReady = true;
+
+	/* sources failed to load */
+	if( ID == 0 )
+		return;
+
+	if( !FinishProgram( ID, Build ) )
+	{
+		/* delete the program */
+		glDeleteProgram( ID );
+		ID = 0;
+		return;
+	}
+
+	Permutations[ GetPermutationHash() ] = ID;
+}
+
+bool FShader::FinishProgram( GLuint program, FProgramBuild& build )
+{
+	GLint result;
+
+	/* binary from the cache is already linked */
+	if( build.bLoadedFromCache )
+		return true;
+
+	/* print compile errors of every stage */
+	for( const FPendingShader& pending : build.PendingShaders )
+	{
+		ShaderCheckCompile( pending.Shader, pending.FilePath );
+
+		/* delete the shader - it won't actually be
+		* destroyed until the program that it's attached
+		* to has been destroyed */
+		glDeleteShader( pending.Shader );
+	}
+	build.PendingShaders.clear();
+
+	/* make sure that there were no link errors */
+	glGetProgramiv( program, GL_LINK_STATUS, &result );
 	if( result == GL_FALSE )
 	{
 		GLint length;
 		char* log;
 
 		/* get the program info log */
-		glGetProgramiv( g_program, GL_INFO_LOG_LENGTH, &length );
+		glGetProgramiv( program, GL_INFO_LOG_LENGTH, &length );
 		log = (char*)malloc( length );
-		glGetProgramInfoLog( g_program, length, &result, log );
+		glGetProgramInfoLog( program, length, &result, log );
 
 		/* print an error message and the info log */
 		fprintf( stderr, "sceneInit(): Program linking failed: %s\n", log );
 		free( log );
-
-		/* delete the program */
-		glDeleteProgram( g_program );
-		g_program = 0;
+		return false;
 	}
-	return g_program;
+
+	if( !build.CachePath.empty() )
+		ProgramSaveBinary( program, build.CachePath.c_str() );
+	return true;
 }
\ No newline at end of file
@@ -2,25 +2,87 @@
 
 #include <iostream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <glad/glad.h>
 
 #include "glm/glm.hpp"
 
+#include "Render/StateCache.h"
+
+// Non-owning view of a shader source file loaded by FShader, valid until the file is invalidated.
+struct FShaderSourceView
+{
+	const char* Data = nullptr;
+	size_t Size = 0;
+	// Hash of the contents, keys the preprocessor output and the program cache.
+	unsigned long long Hash = 0;
+};
+
 class FShader
 {
 public:
 
-	FShader(const char* inName, const char* vertex_path, const char* fragment_path );
+	// inLinearOutput - shader writes linear color and relies on the sRGB framebuffer to encode it.
+	// inDefines - "NAME" or "NAME VALUE" injected into every stage, selecting the permutation.
+	FShader(const char* inName, const char* vertex_path, const char* fragment_path, bool inLinearOutput = true,
+		const std::vector<std::string>& inDefines = std::vector<std::string>() );
 	
+    // Compiles and links the program if not done yet, blocking until it is finished.
     virtual void Init();
 
+    // Starts compiling the program without waiting for the driver.
+    void Submit();
+    // Returns true once the submitted program is finished, never blocks with KHR_parallel_shader_compile.
+    bool Poll();
+    bool IsSubmitted() const { return bSubmitted; };
+    bool IsReady() const { return bReady; };
+
+    // Deletes programs of every permutation, the next use compiles again.
+    void Release();
+
+    // Lets the driver compile programs on its own threads, returns false if not supported.
+    static bool EnableParallelCompile();
+
+    // Drops the cached contents of the file, e.g. when it changed on disk.
+    static void InvalidateSource(const std::string& file_path);
+
+    // Writes preprocessed sources of every compiled permutation for Tools/optimize_shaders.py.
+    static void SetDumpPreprocessed(bool bDump) { bDumpPreprocessed = bDump; };
+
+    // Starts compiling the program from the current sources, e.g. after they were edited.
+    // Program not ready yet is submitted again instead, nothing is drawn with it until then.
+    void Reload();
+    // Swaps in the reloaded program once it is linked, returns true if swapped.
+    // Failed reload keeps the previous program.
+    bool PollReload();
+    bool IsReloading() const { return ReloadID != 0; };
+    // File is one of the sources or includes of the program.
+    bool DependsOn(const std::string& file_path) const;
+
+    bool HasDefine(const std::string& define) const;
+    // Switches to the permutation with define added or removed. Nothing is compiled here, the shader is
+    // not ready until submitted again. Uniforms have to be set again after switching.
+    // Reload in progress is restarted with the new define set.
+    void SetDefine(const std::string& define, bool enabled);
+
     const std::string& GetName() { return Name; };
 
+    bool IsLinearOutput() const { return bLinearOutput; };
+
+    // Program was loaded from the binary cache instead of compiling sources.
+    bool IsLoadedFromCache() const { return Build.bLoadedFromCache; };
+
+    // Stores startup time of all the shaders next to the binary cache, for cold (not all programs from the cache)
+    // or warm start. Returns the last cold and warm time, the current start included, 0 if there was none.
+    static void RecordLoadTime( bool warm, float milliseconds, float& cold_milliseconds, float& warm_milliseconds );
+
     unsigned int GetID()const{ return ID; };
+    // Program has to be ready, compiled by Init() or Submit() and Poll(), so the owner knows when it finished.
     void Use()
     {
-        glUseProgram( ID );
+        FStateCache::Get().UseProgram( ID );
     }
     void SetBool( const std::string& name, bool value ) const
     {
@@ -77,21 +139,113 @@ private:
     const char* VertexPath;
     const char* FragmentPath;
 
-    unsigned int ID;
+    bool bLinearOutput = true;
+    bool bSubmitted = false;
+    bool bReady = false;
+
+    struct FPendingShader
+    {
+        GLuint Shader;
+        const char* FilePath;
+    };
+    // State of a program from LoadShaders() until it is finished.
+    struct FProgramBuild
+    {
+        // Shaders attached to the program which is still being linked.
+        std::vector<FPendingShader> PendingShaders;
+        std::string CachePath;
+        bool bLoadedFromCache = false;
+    };
+    // Of ID and of ReloadID, both may be in flight at once.
+    FProgramBuild Build;
+    FProgramBuild ReloadBuild;
+    // Sources and includes of every stage.
+    std::vector<std::string> SourceFiles;
+    GLuint ReloadID = 0;
+
+    std::vector<std::string> Defines;
+    // Programs of every permutation compiled so far, keyed by define set hash.
+    std::unordered_map<unsigned long long, GLuint> Permutations;
+
+    static bool bParallelCompile;
+    static bool bDumpPreprocessed;
+
+    struct FSourceFile
+    {
+        std::string Text;
+        unsigned long long Hash;
+    };
+    // Contents of every source file read so far, keyed by path.
+    static std::unordered_map<std::string, FSourceFile> SourceCache;
+
+    unsigned int ID = 0;
 	/*
-	* Returns a string containing the text in
-	* a vertex/fragment shader source file.
+	* Returns a view of the text in a shader source
+	* file, read with a single call on first use.
 	*/
-	static char* ShaderLoadSource( const char* file_path );
+	static bool ShaderLoadSource( const std::string& file_path, FShaderSourceView& view );
+	/*
+	* Appends the file to source with #include "path"
+	* directives replaced by the included files.
+	*/
+	static bool ShaderResolveIncludes( const std::string& file_path, std::vector<std::string>& included, std::string& source, unsigned long long& hash );
+	/*
+	* Returns source with includes resolved and stage and permutation
+	* defines injected after #version, appends all used files to files.
+	* Hash is computed from content hashes of the files and the defines.
+	*/
+	bool ShaderPreprocess( const char* file_path, const char* stage_define, std::string& source, std::vector<std::string>& files, unsigned long long& hash ) const;
+	/*
+	* Replaces source with its offline optimised version
+	* if there is one, dumps it first when requested.
+	*/
+	static void ShaderUseOptimized( std::string& source, unsigned long long& hash, const char* extension );
 	/*
 	* Returns a shader object containing a shader
-	* compiled from the given GLSL shader file.
+	* compiled from the given GLSL source.
 	*/
-	static GLuint ShaderCompileFromFile( GLenum type, const char* file_path );
+	static GLuint ShaderCompileFromSource( GLenum type, const std::string& source );
+	/*
+	* Prints the info log of the shader if it
+	* failed to compile, returns false then.
+	*/
+	static bool ShaderCheckCompile( GLuint shader, const char* file_path );
 	/*
 	* Compiles and attaches a shader of the
 	* given type to the given program object.
 	*/
-	void ShaderAttachFromFile( GLuint program, GLenum type, const char* file_path );
-	int LoadShaders( const char* vertex_path, const char* fragment_path, const char* geometry_path = NULL );
+	static void ShaderAttachFromSource( GLuint program, GLenum type, const std::string& source, const char* file_path, FProgramBuild& build );
+	/*
+	* Returns path of the program binary in the cache, keyed by hashes of the
+	* preprocessed sources, driver vendor, renderer and version and the define set.
+	* Empty if the driver does not support program binaries.
+	*/
+	static std::string ProgramCachePath( const unsigned long long* source_hashes, int count, unsigned long long permutation );
+	/*
+	* Returns program loaded from the binary, 0 if missing or rejected by the driver.
+	*/
+	static GLuint ProgramLoadBinary( const char* cache_path );
+	static void ProgramSaveBinary( GLuint program, const char* cache_path );
+	/*
+	* Loads program from the binary cache or starts compiling and linking it from sources.
+	*/
+	int LoadShaders( FProgramBuild& build, const char* vertex_path, const char* fragment_path, const char* geometry_path = NULL );
+	/*
+	* Deletes the program which is still being linked and its shaders.
+	*/
+	static void CancelBuild( GLuint& program, FProgramBuild& build );
+	/*
+	* Deletes programs of every permutation, e.g. built from old sources.
+	*/
+	void DeletePermutations();
+	/*
+	* Returns hash of the define set.
+	*/
+	unsigned long long GetPermutationHash() const;
+	/*
+	* Checks compile and link status of the
+	* submitted program and caches its binary.
+	*/
+	void Finish();
+	static bool FinishProgram( GLuint program, FProgramBuild& build );
 };
\ No newline at end of file
@@ -0,0 +1,248 @@
+#include "ShaderWatcher.h"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FShaderWatcher::~FShaderWatcher()
+{
+	Stop();
+}
+
+void FShaderWatcher::AddChange(std::string File)
+{
+	std::replace(File.begin(), File.end(), '\\', '/');
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+	Changes.insert(Directory + "/" + File);
+}
+
+std::vector<std::string> FShaderWatcher::TakeChanges()
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	std::vector<std::string> Result(Changes.begin(), Changes.end());
+	Changes.clear();
+	return Result;
+}
+
+bool FShaderWatcher::HasChanges() const
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	return !Changes.empty();
+}
+
+#ifdef _WIN32
+
+bool FShaderWatcher::Start(const std::string& inDirectory)
+{
+	Stop();
+
+	Directory = inDirectory;
+
+	DirectoryHandle = CreateFileA(Directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+	if (DirectoryHandle == INVALID_HANDLE_VALUE)
+	{
+		DirectoryHandle = nullptr;
+		std::cout << "Failed to watch shader directory " << Directory << std::endl;
+		return false;
+	}
+
+	StopEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+	if (!StopEvent)
+	{
+		CloseHandle(DirectoryHandle);
+		DirectoryHandle = nullptr;
+		std::cout << "Failed to watch shader directory " << Directory << std::endl;
+		return false;
+	}
+
+	bStop = false;
+	Watcher = std::thread(&FShaderWatcher::Watch, this);
+	return true;
+}
+
+void FShaderWatcher::Stop()
+{
+	if (!Watcher.joinable())
+	{
+		return;
+	}
+
+	bStop = true;
+	// Read is overlapped, the watcher waits for it or for this event and cancels the read itself.
+	SetEvent(StopEvent);
+	Watcher.join();
+
+	CloseHandle(StopEvent);
+	StopEvent = nullptr;
+	CloseHandle(DirectoryHandle);
+	DirectoryHandle = nullptr;
+}
+
+void FShaderWatcher::Watch()
+{
+	alignas(DWORD) char Buffer[16 * 1024];
+
+	HANDLE ReadEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+	if (!ReadEvent)
+	{
+		return;
+	}
+
+	while (!bStop)
+	{
+		OVERLAPPED Overlapped = {};
+		Overlapped.hEvent = ReadEvent;
+		ResetEvent(ReadEvent);
+
+		if (!ReadDirectoryChangesW(DirectoryHandle, Buffer, sizeof(Buffer), TRUE,
+			FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, nullptr, &Overlapped, nullptr))
+		{
+			break;
+		}
+
+		const HANDLE Events[2] = { ReadEvent, StopEvent };
+		DWORD Bytes = 0;
+		if (WaitForMultipleObjects(2, Events, FALSE, INFINITE) != WAIT_OBJECT_0)
+		{
+			// Buffer has to outlive the read, so wait for the cancellation to finish.
+			CancelIo(DirectoryHandle);
+			GetOverlappedResult(DirectoryHandle, &Overlapped, &Bytes, TRUE);
+			break;
+		}
+
+		if (!GetOverlappedResult(DirectoryHandle, &Overlapped, &Bytes, FALSE))
+		{
+			break;
+		}
+
+		for (size_t Offset = 0; Bytes > 0;)
+		{
+			const FILE_NOTIFY_INFORMATION* Info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(Buffer + Offset);
+
+			if (Info->Action == FILE_ACTION_MODIFIED || Info->Action == FILE_ACTION_ADDED || Info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+			{
+				const int Length = static_cast<int>(Info->FileNameLength / sizeof(WCHAR));
+				std::string File(WideCharToMultiByte(CP_UTF8, 0, Info->FileName, Length, nullptr, 0, nullptr, nullptr), '\0');
+				WideCharToMultiByte(CP_UTF8, 0, Info->FileName, Length, &File[0], static_cast<int>(File.size()), nullptr, nullptr);
+
+				AddChange(File);
+			}
+
+			if (Info->NextEntryOffset == 0)
+			{
+				break;
+			}
+			Offset += Info->NextEntryOffset;
+		}
+	}
+
+	CloseHandle(ReadEvent);
+}
+
+#else
+
+bool FShaderWatcher::Start(const std::string& inDirectory)
+{
+	Stop();
+
+	Directory = inDirectory;
+
+	Notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (Notify < 0)
+	{
+		std::cout << "Failed to watch shader directory " << Directory << std::endl;
+		return false;
+	}
+
+	// inotify is not recursive, every subdirectory (shader libraries) is watched separately.
+	std::vector<std::string> Subdirectories = { "" };
+	if (DIR* Dir = opendir(Directory.c_str()))
+	{
+		while (dirent* Entry = readdir(Dir))
+		{
+			if (Entry->d_type == DT_DIR && Entry->d_name[0] != '.')
+			{
+				Subdirectories.push_back(std::string(Entry->d_name) + "/");
+			}
+		}
+		closedir(Dir);
+	}
+
+	for (const std::string& Subdirectory : Subdirectories)
+	{
+		// Editors either write the file in place or rename a temporary file over it.
+		const int Watch = inotify_add_watch(Notify, (Directory + "/" + Subdirectory).c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (Watch >= 0)
+		{
+			Watches.emplace_back(Watch, Subdirectory);
+		}
+	}
+
+	bStop = false;
+	Watcher = std::thread(&FShaderWatcher::Watch, this);
+	return true;
+}
+
+void FShaderWatcher::Stop()
+{
+	if (Watcher.joinable())
+	{
+		bStop = true;
+		Watcher.join();
+	}
+
+	if (Notify >= 0)
+	{
+		close(Notify);
+		Notify = -1;
+	}
+	Watches.clear();
+}
+
+void FShaderWatcher::Watch()
+{
+	alignas(inotify_event) char Buffer[16 * 1024];
+
+	while (!bStop)
+	{
+		// Timeout lets Stop() end the thread.
+		pollfd Poll = { Notify, POLLIN, 0 };
+		if (poll(&Poll, 1, 100) <= 0)
+		{
+			continue;
+		}
+
+		const ssize_t Bytes = read(Notify, Buffer, sizeof(Buffer));
+		for (ssize_t Offset = 0; Offset < Bytes;)
+		{
+			const inotify_event* Event = reinterpret_cast<const inotify_event*>(Buffer + Offset);
+
+			if (Event->len > 0)
+			{
+				auto Watch = std::find_if(Watches.begin(), Watches.end(),
+					[Event](const std::pair<int, std::string>& Entry) { return Entry.first == Event->wd; });
+				if (Watch != Watches.end())
+				{
+					AddChange(Watch->second + Event->name);
+				}
+			}
+
+			Offset += sizeof(inotify_event) + Event->len;
+		}
+	}
+}
+
+#endif
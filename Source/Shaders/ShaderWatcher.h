@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Watches shader directory and its subdirectories for modified files on a background thread.
+// Uses ReadDirectoryChangesW on Windows and inotify elsewhere.
+class FShaderWatcher
+{
+public:
+	FShaderWatcher() = default;
+	~FShaderWatcher();
+
+	FShaderWatcher(const FShaderWatcher&) = delete;
+	FShaderWatcher& operator=(const FShaderWatcher&) = delete;
+
+	bool Start(const std::string& inDirectory);
+	void Stop();
+
+	// Returns paths (with forward slashes, prefixed by the watched directory) changed since the last call.
+	std::vector<std::string> TakeChanges();
+	bool HasChanges() const;
+
+private:
+
+	void Watch();
+	void AddChange(std::string File);
+
+	std::string Directory;
+
+	std::thread Watcher;
+	std::atomic<bool> bStop{ false };
+
+	mutable std::mutex Mutex;
+	std::unordered_set<std::string> Changes;
+
+#ifdef _WIN32
+	void* DirectoryHandle = nullptr;
+	// Signaled by Stop(), the watcher waits on it next to the overlapped read.
+	void* StopEvent = nullptr;
+#else
+	int Notify = -1;
+	// Watch descriptor to the watched subdirectory.
+	std::vector<std::pair<int, std::string>> Watches;
+#endif
+};
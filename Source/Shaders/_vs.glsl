@@ -3,10 +3,27 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#ifdef VERTEX_TANGENTS
+layout (location = 3) in vec4 aTangent;
+#endif
+#ifdef TEXTURE_ARRAY
+// Per instance : offset and material layer.
+layout (location = 4) in vec4 aInstance;
+#endif
 
 out vec2 TexCoords;
 out vec3 WorldPos;
 out vec3 Normal;
+#ifdef VERTEX_TANGENTS
+out vec3 Tangent;
+out vec3 Bitangent;
+#endif
+#ifdef TEXTURE_ARRAY
+flat out float Layer;
+#endif
+
+// Depth pre-pass computes the same position in depth_vs.glsl.
+invariant gl_Position;
 
 uniform mat4 Projection;
 uniform mat4 View;
@@ -18,5 +35,16 @@ void main()
     WorldPos = vec3(Model * vec4(aPos, 1.0));
     Normal = mat3(Model) * aNormal;   
 
+#ifdef VERTEX_TANGENTS
+    Tangent = mat3(Model) * aTangent.xyz;
+    // Tangent.w is the bitangent sign (handedness of the uv mapping).
+    Bitangent = cross(Normal, Tangent) * aTangent.w;
+#endif
+
+#ifdef TEXTURE_ARRAY
+    Layer = aInstance.w;
+    WorldPos += aInstance.xyz;
+#endif
+
     gl_Position =  Projection * View * vec4(WorldPos, 1.0);
 }
\ No newline at end of file
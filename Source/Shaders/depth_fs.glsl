@@ -0,0 +1,7 @@
+#version 330 core
+
+// Depth pre-pass writes depth only, color writes are masked.
+
+void main()
+{
+}
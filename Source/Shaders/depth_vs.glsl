@@ -0,0 +1,27 @@
+#version 330 core
+
+// Depth pre-pass, position only. Clip position is computed with the same expressions as in _vs.glsl
+// and gouraud_vs.glsl, so the shading pass after it passes the GL_EQUAL depth test.
+
+layout (location = 0) in vec3 aPos;
+#ifdef TEXTURE_ARRAY
+// Per instance : offset and material layer.
+layout (location = 4) in vec4 aInstance;
+#endif
+
+invariant gl_Position;
+
+uniform mat4 Projection;
+uniform mat4 View;
+uniform mat4 Model;
+
+void main()
+{
+    vec3 WorldPos = vec3(Model * vec4(aPos, 1.0));
+
+#ifdef TEXTURE_ARRAY
+    WorldPos += aInstance.xyz;
+#endif
+
+    gl_Position =  Projection * View * vec4(WorldPos, 1.0);
+}
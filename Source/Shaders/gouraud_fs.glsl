@@ -1,8 +1,9 @@
 #version 330 core
 
-in vec4 FragColor;
+out vec4 FragColor;
+in vec4 VertexColor;
 
 void main()
 {
-	gl_FragColor = FragColor;
+	FragColor = VertexColor;
 }
\ No newline at end of file
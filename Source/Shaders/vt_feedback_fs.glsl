@@ -0,0 +1,22 @@
+#version 330 core
+
+// Virtual texture feedback, see Texture/VirtualTexture.h.
+// Writes sampled uv and lod, alpha marks pixels covered by textured geometry.
+
+out vec4 FragColor;
+in vec2 TexCoords;
+in vec3 WorldPos;
+in vec3 Normal;
+
+uniform float FeedbackDivisor;
+
+void main()
+{
+    vec2 Dx = dFdx(TexCoords);
+    vec2 Dy = dFdy(TexCoords);
+
+    // Feedback is rendered at lower resolution, so derivatives are FeedbackDivisor times larger.
+    float Lod = 0.5 * log2(max(dot(Dx, Dx), dot(Dy, Dy))) - log2(FeedbackDivisor);
+
+    FragColor = vec4(fract(TexCoords), Lod, 1.0);
+}
\ No newline at end of file
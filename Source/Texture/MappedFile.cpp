@@ -0,0 +1,124 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FMappedFile::~FMappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool FMappedFile::Open(const char* file_name)
+{
+	Close();
+
+	File = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+	{
+		File = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER FileSize;
+	if (!GetFileSizeEx(File, &FileSize) || FileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!Mapping)
+	{
+		Close();
+		return false;
+	}
+
+	Data = static_cast<const unsigned char*>(MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!Data)
+	{
+		Close();
+		return false;
+	}
+
+	Size = static_cast<size_t>(FileSize.QuadPart);
+	return true;
+}
+
+void FMappedFile::Close()
+{
+	if (Data)
+	{
+		UnmapViewOfFile(Data);
+	}
+	if (Mapping)
+	{
+		CloseHandle(Mapping);
+	}
+	if (File)
+	{
+		CloseHandle(File);
+	}
+
+	Data = nullptr;
+	Mapping = nullptr;
+	File = nullptr;
+	Size = 0;
+}
+
+#else
+
+bool FMappedFile::Open(const char* file_name)
+{
+	Close();
+
+	const int File = open(file_name, O_RDONLY);
+	if (File < 0)
+	{
+		return false;
+	}
+
+	struct stat FileStat;
+	if (fstat(File, &FileStat) != 0 || FileStat.st_size == 0)
+	{
+		close(File);
+		return false;
+	}
+
+	void* MappedData = mmap(nullptr, static_cast<size_t>(FileStat.st_size), PROT_READ, MAP_PRIVATE, File, 0);
+	// Mapping keeps its own reference to the file.
+	close(File);
+
+	if (MappedData == MAP_FAILED)
+	{
+		return false;
+	}
+
+	madvise(MappedData, static_cast<size_t>(FileStat.st_size), MADV_SEQUENTIAL);
+
+	Data = static_cast<const unsigned char*>(MappedData);
+	Size = static_cast<size_t>(FileStat.st_size);
+	return true;
+}
+
+void FMappedFile::Close()
+{
+	if (Data)
+	{
+		munmap(const_cast<unsigned char*>(Data), Size);
+	}
+
+	Data = nullptr;
+	Size = 0;
+}
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+// Read only memory mapping of the whole file.
+// Pages are loaded by the OS on first access and can be dropped at any time,
+// so mapped data does not count towards private memory of the process.
+class FMappedFile
+{
+public:
+	FMappedFile() = default;
+	~FMappedFile();
+
+	FMappedFile(const FMappedFile&) = delete;
+	FMappedFile& operator=(const FMappedFile&) = delete;
+
+	bool Open(const char* file_name);
+	void Close();
+
+	const unsigned char* GetData() const { return Data; };
+	size_t GetSize() const { return Size; };
+
+private:
+	const unsigned char* Data = nullptr;
+	size_t Size = 0;
+
+#ifdef _WIN32
+	void* File = nullptr;
+	void* Mapping = nullptr;
+#endif
+};
@@ -0,0 +1,71 @@
+#include "RenderTarget.h"
+
+#include "Render/StateCache.h"
+
+FRenderTarget::~FRenderTarget()
+{
+	Shutdown();
+}
+
+bool FRenderTarget::Init(int inWidth, int inHeight, GLenum inColorFormat)
+{
+	Shutdown();
+
+	Width = inWidth;
+	Height = inHeight;
+
+	glGenTextures(1, &Color);
+	FStateCache::Get().BindTexture(GL_TEXTURE_2D, Color);
+	glTexImage2D(GL_TEXTURE_2D, 0, inColorFormat, Width, Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	FStateCache::Get().BindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &Depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, Depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, Width, Height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLint Previous = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &Previous);
+
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, Color, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, Depth);
+	const bool bComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, Previous);
+
+	if (!bComplete)
+	{
+		Shutdown();
+	}
+	return bComplete;
+}
+
+void FRenderTarget::Shutdown()
+{
+	if (FBO != 0)
+	{
+		glDeleteFramebuffers(1, &FBO);
+		FBO = 0;
+	}
+	if (Color != 0)
+	{
+		FStateCache::Get().DeleteTextures(1, &Color);
+		Color = 0;
+	}
+	if (Depth != 0)
+	{
+		glDeleteRenderbuffers(1, &Depth);
+		Depth = 0;
+	}
+}
+
+void FRenderTarget::Bind() const
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glViewport(0, 0, Width, Height);
+}
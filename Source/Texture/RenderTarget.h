@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Offscreen framebuffer with color texture and depth renderbuffer.
+// sRGB color format matches the default framebuffer, so shaders writing linear color work the same with GL_FRAMEBUFFER_SRGB.
+class FRenderTarget
+{
+public:
+
+	~FRenderTarget();
+
+	// Returns false if the framebuffer is not complete.
+	bool Init(int inWidth, int inHeight, GLenum inColorFormat = GL_SRGB8_ALPHA8);
+	void Shutdown();
+
+	// Binds framebuffer and sets viewport to its size.
+	void Bind() const;
+
+	GLuint GetFBO() const { return FBO; };
+	GLuint GetColorID() const { return Color; };
+	int GetWidth() const { return Width; };
+	int GetHeight() const { return Height; };
+
+private:
+
+	GLuint FBO = 0;
+	GLuint Color = 0;
+	GLuint Depth = 0;
+	int Width = 0;
+	int Height = 0;
+};
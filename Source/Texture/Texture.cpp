@@ -1,28 +1,107 @@
 #include "Texture.h"
 
+#include <cstdint>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "stb_image.h"
+#include "MappedFile.h"
+#include "Render/StateCache.h"
 
-void FTexture::LoadTextureFromFile( const char* file_name )
+namespace
 {
-	ID = 0;
+	// Pre-baked texture : header followed by tightly packed mip levels, finest first.
+	struct FTextureCacheHeader
+	{
+		char Magic[4] = { 'P', 'B', 'T', 'X' };
+		uint32_t Version = 2;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		uint32_t Components = 0;
+		uint32_t MipCount = 0;
+		// Image the texture was baked from.
+		uint64_t SourceTime = 0;
+		uint64_t SourceSize = 0;
+	};
 
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(file_name, &width, &height, &nrComponents, 0);
-	if (data)
+	bool GetFormats(int nrComponents, ETextureColorSpace ColorSpace, GLenum& format, GLenum& internalFormat)
 	{
-		GLenum format;
 		if (nrComponents == 1)
 			format = GL_RED;
 		else if (nrComponents == 3)
 			format = GL_RGB;
 		else if (nrComponents == 4)
 			format = GL_RGBA;
+		else
+			return false;
+
+		// sRGB images are decoded to linear by the hardware when sampled.
+		internalFormat = format;
+		if (ColorSpace == ETextureColorSpace::ESRGB)
+		{
+			if (nrComponents == 3)
+				internalFormat = GL_SRGB8;
+			else if (nrComponents == 4)
+				internalFormat = GL_SRGB8_ALPHA8;
+		}
+
+		return true;
+	}
+
+	size_t GetMipSize(const FTextureCacheHeader& Header, uint32_t Mip)
+	{
+		const size_t MipWidth = Header.Width >> Mip ? Header.Width >> Mip : 1;
+		const size_t MipHeight = Header.Height >> Mip ? Header.Height >> Mip : 1;
+		return MipWidth * MipHeight * Header.Components;
+	}
+}
+
+bool GetFileStamp(const char* file_name, uint64_t& Time, uint64_t& Size)
+{
+#ifdef _WIN32
+	struct _stat64 Info;
+	if (_stat64(file_name, &Info) != 0)
+#else
+	struct stat Info;
+	if (stat(file_name, &Info) != 0)
+#endif
+	{
+		return false;
+	}
+
+	Time = uint64_t(Info.st_mtime);
+	Size = uint64_t(Info.st_size);
+	return true;
+}
+
+void FTexture::LoadTextureFromFile( const char* file_name, ETextureColorSpace ColorSpace )
+{
+	Release();
 
+	uint64_t SourceTime = 0;
+	uint64_t SourceSize = 0;
+	GetFileStamp(file_name, SourceTime, SourceSize);
+
+	const std::string CachePath = std::string(file_name) + ".tex";
+	if (LoadTextureFromCache(CachePath.c_str(), ColorSpace, SourceTime, SourceSize))
+	{
+		return;
+	}
+
+	int width, height, nrComponents;
+	unsigned char* data = stbi_load(file_name, &width, &height, &nrComponents, 0);
+	GLenum format, internalFormat;
+	if (data && GetFormats(nrComponents, ColorSpace, format, internalFormat))
+	{
 		glGenTextures(1, &ID);
-		glBindTexture(GL_TEXTURE_2D, ID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+		FStateCache::Get().BindTexture(GL_TEXTURE_2D, ID);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 		glGenerateMipmap(GL_TEXTURE_2D);
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -31,10 +110,123 @@ void FTexture::LoadTextureFromFile( const char* file_name )
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 		stbi_image_free(data);
+
+		SaveTextureToCache(CachePath.c_str(), width, height, nrComponents, format, SourceTime, SourceSize);
 	}
 	else
 	{
 		std::cout << "Texture failed to load at path: " << file_name << std::endl;
 		stbi_image_free(data);
 	}
+}
+
+void FTexture::Release()
+{
+	if (ID)
+	{
+		FStateCache::Get().DeleteTextures(1, &ID);
+		ID = 0;
+	}
+}
+
+bool FTexture::LoadTextureFromCache( const char* file_name, ETextureColorSpace ColorSpace, uint64_t SourceTime, uint64_t SourceSize )
+{
+	FMappedFile File;
+	if (!File.Open(file_name) || File.GetSize() < sizeof(FTextureCacheHeader))
+	{
+		return false;
+	}
+
+	FTextureCacheHeader Header;
+	memcpy(&Header, File.GetData(), sizeof(Header));
+
+	const FTextureCacheHeader Expected;
+	GLenum format, internalFormat;
+	if (memcmp(Header.Magic, Expected.Magic, sizeof(Expected.Magic)) != 0 || Header.Version != Expected.Version ||
+		Header.MipCount == 0 || !GetFormats(Header.Components, ColorSpace, format, internalFormat))
+	{
+		return false;
+	}
+
+	// Image changed since baking.
+	if (SourceSize != 0 && (Header.SourceTime != SourceTime || Header.SourceSize != SourceSize))
+	{
+		return false;
+	}
+
+	size_t DataSize = 0;
+	for (uint32_t Mip = 0; Mip < Header.MipCount; ++Mip)
+	{
+		DataSize += GetMipSize(Header, Mip);
+	}
+	if (File.GetSize() < sizeof(Header) + DataSize)
+	{
+		std::cout << "Texture cache is truncated: " << file_name << std::endl;
+		return false;
+	}
+
+	glGenTextures(1, &ID);
+	FStateCache::Get().BindTexture(GL_TEXTURE_2D, ID);
+
+	// Upload reads straight from the mapped pages, the driver copies client memory before glTexImage2D returns,
+	// so the mapping is released as soon as the last mip is submitted.
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	const unsigned char* MipData = File.GetData() + sizeof(Header);
+	for (uint32_t Mip = 0; Mip < Header.MipCount; ++Mip)
+	{
+		const GLsizei MipWidth = Header.Width >> Mip ? Header.Width >> Mip : 1;
+		const GLsizei MipHeight = Header.Height >> Mip ? Header.Height >> Mip : 1;
+
+		glTexImage2D(GL_TEXTURE_2D, Mip, internalFormat, MipWidth, MipHeight, 0, format, GL_UNSIGNED_BYTE, MipData);
+		MipData += GetMipSize(Header, Mip);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, Header.MipCount - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	return true;
+}
+
+void FTexture::SaveTextureToCache( const char* file_name, int width, int height, int nrComponents, GLenum format, uint64_t SourceTime, uint64_t SourceSize ) const
+{
+	FTextureCacheHeader Header;
+	Header.Width = width;
+	Header.Height = height;
+	Header.Components = nrComponents;
+	Header.SourceTime = SourceTime;
+	Header.SourceSize = SourceSize;
+	while ((width >> Header.MipCount) > 0 || (height >> Header.MipCount) > 0)
+	{
+		++Header.MipCount;
+	}
+
+	std::ofstream File(file_name, std::ios::binary | std::ios::trunc);
+	if (!File)
+	{
+		return;
+	}
+
+	File.write((const char*)&Header, sizeof(Header));
+
+	// Mips generated by the driver are read back, so the cache holds the same data as the regular path.
+	std::vector<unsigned char> MipData;
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	for (uint32_t Mip = 0; Mip < Header.MipCount; ++Mip)
+	{
+		MipData.resize(GetMipSize(Header, Mip));
+		glGetTexImage(GL_TEXTURE_2D, Mip, format, GL_UNSIGNED_BYTE, MipData.data());
+		File.write((const char*)MipData.data(), MipData.size());
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	if (!File)
+	{
+		std::cout << "Unable to write texture cache " << file_name << std::endl;
+	}
 }
\ No newline at end of file
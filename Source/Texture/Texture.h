@@ -1,13 +1,37 @@
 #pragma once
 
+#include <cstdint>
+
 #include <glad/glad.h>
 
+// How texel values stored in the image file should be interpreted.
+// Color data (albedo) is authored in sRGB and decoded to linear by the sampler,
+// everything else (normals, metallic, roughness) is stored as is.
+enum class ETextureColorSpace
+{
+	ELinear,
+	ESRGB,
+};
+
+// Modification time and size of the file, false if it does not exist.
+// Baked textures store the stamp of their source image to notice when it changes.
+bool GetFileStamp(const char* file_name, uint64_t& Time, uint64_t& Size);
+
 class FTexture
 {
 public:
 	GLuint GetID() const { return ID; };
-	void LoadTextureFromFile(const char* file_name);
+	// Loads pre-baked texture (file_name + ".tex") with all mips through memory mapping,
+	// otherwise decodes the image and bakes it for the next run. Texture baked from an image
+	// of different modification time or size is baked again.
+	void LoadTextureFromFile(const char* file_name, ETextureColorSpace ColorSpace = ETextureColorSpace::ELinear);
+	// Deletes the texture, ID is 0 afterwards.
+	void Release();
 
 private:
-	GLuint ID;
+	// Source time and size of zero skip the staleness check, e.g. when only the baked texture is shipped.
+	bool LoadTextureFromCache(const char* file_name, ETextureColorSpace ColorSpace, uint64_t SourceTime, uint64_t SourceSize);
+	void SaveTextureToCache(const char* file_name, int width, int height, int nrComponents, GLenum format, uint64_t SourceTime, uint64_t SourceSize) const;
+
+	GLuint ID = 0;
 };
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "TextureArray.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "stb_image.h"
+
+#include "Render/StateCache.h"
+
+bool FTextureArray::LoadTexturesFromFiles(const std::vector<std::string>& FileNames, ETextureColorSpace ColorSpace)
+{
+	Layers = static_cast<int>(FileNames.size());
+	if (Layers == 0)
+	{
+		return false;
+	}
+
+	// Layers are rows of bytes without padding for 1 and 3 component images.
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	bool bLoaded = true;
+	int Components = 0;
+	GLenum format = GL_RGBA;
+	for (int Layer = 0; Layer < Layers && bLoaded; ++Layer)
+	{
+		int width, height, nrComponents;
+		// Later layers are converted to the component count of the first one.
+		unsigned char* data = stbi_load(FileNames[Layer].c_str(), &width, &height, &nrComponents, Components);
+		if (!data)
+		{
+			std::cout << "Texture failed to load at path: " << FileNames[Layer] << std::endl;
+			bLoaded = false;
+			break;
+		}
+
+		if (Layer == 0)
+		{
+			Components = nrComponents;
+			Width = width;
+			Height = height;
+
+			const bool bSRGB = ColorSpace == ETextureColorSpace::ESRGB;
+			GLenum internalFormat;
+			if (Components == 1)
+			{
+				format = GL_RED;
+				internalFormat = GL_R8;
+			}
+			else if (Components == 2)
+			{
+				format = GL_RG;
+				internalFormat = GL_RG8;
+			}
+			else if (Components == 3)
+			{
+				format = GL_RGB;
+				internalFormat = bSRGB ? GL_SRGB8 : GL_RGB8;
+			}
+			else
+			{
+				format = GL_RGBA;
+				internalFormat = bSRGB ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+			}
+
+			AllocateStorage(internalFormat, format);
+		}
+		else if (width != Width || height != Height)
+		{
+			std::cout << "Texture array layers have to be the same size: " << FileNames[Layer] << std::endl;
+			bLoaded = false;
+		}
+
+		if (bLoaded)
+		{
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, Layer, Width, Height, 1, format, GL_UNSIGNED_BYTE, data);
+		}
+
+		stbi_image_free(data);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	if (!bLoaded)
+	{
+		return false;
+	}
+
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	return true;
+}
+
+void FTextureArray::AllocateStorage(GLenum internalFormat, GLenum format)
+{
+	int MipCount = 1;
+	while ((std::max(Width, Height) >> MipCount) > 0)
+	{
+		++MipCount;
+	}
+
+	glGenTextures(1, &ID);
+	FStateCache::Get().BindTexture(GL_TEXTURE_2D_ARRAY, ID);
+
+	if (GLAD_GL_VERSION_4_2)
+	{
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, MipCount, internalFormat, Width, Height, Layers);
+	}
+	else
+	{
+		for (int Mip = 0; Mip < MipCount; ++Mip)
+		{
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, Mip, internalFormat,
+				std::max(1, Width >> Mip), std::max(1, Height >> Mip), Layers, 0, format, GL_UNSIGNED_BYTE, nullptr);
+		}
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, MipCount - 1);
+	}
+}
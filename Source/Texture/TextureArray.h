@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Texture/Texture.h"
+
+// GL_TEXTURE_2D_ARRAY with one layer per material, all layers have to be the same size.
+// Storage is allocated once for all layers and mips (immutable where GL 4.2 is available).
+class FTextureArray
+{
+public:
+	GLuint GetID() const { return ID; };
+	int GetLayers() const { return Layers; };
+
+	bool LoadTexturesFromFiles(const std::vector<std::string>& FileNames, ETextureColorSpace ColorSpace = ETextureColorSpace::ELinear);
+
+private:
+	void AllocateStorage(GLenum internalFormat, GLenum format);
+
+	GLuint ID = 0;
+
+	int Width = 0;
+	int Height = 0;
+	int Layers = 0;
+};
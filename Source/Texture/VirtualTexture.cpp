@@ -0,0 +1,845 @@
+#include "VirtualTexture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iterator>
+
+#include "stb_image.h"
+
+#include "Profiling/CpuProfiler.h"
+#include "Render/StateCache.h"
+
+namespace
+{
+	struct FVirtualTextureHeader
+	{
+		char Magic[4] = { 'P', 'B', 'V', 'T' };
+		uint32_t Version = 2;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		uint32_t PageSize = VT_PAGE_SIZE;
+		uint32_t PageBorder = VT_PAGE_BORDER;
+		// Image the cache was built from.
+		uint64_t SourceTime = 0;
+		uint64_t SourceSize = 0;
+	};
+
+	// Source size of zero skips the staleness check, e.g. when only the cache is shipped.
+	bool IsValidHeader(const FVirtualTextureHeader& Header, uint64_t SourceTime, uint64_t SourceSize)
+	{
+		const FVirtualTextureHeader Expected;
+		return memcmp(Header.Magic, Expected.Magic, sizeof(Expected.Magic)) == 0
+			&& Header.Version == Expected.Version
+			&& Header.PageSize == Expected.PageSize
+			&& Header.PageBorder == Expected.PageBorder
+			&& Header.Width > 0 && Header.Height > 0
+			&& (SourceSize == 0 || (Header.SourceTime == SourceTime && Header.SourceSize == SourceSize));
+	}
+
+	const int PageTexels = VT_PAGE_SIZE + 2 * VT_PAGE_BORDER;
+	const size_t PageBytes = size_t(PageTexels) * PageTexels * 4;
+
+	int Wrap(int Value, int Size)
+	{
+		return ((Value % Size) + Size) % Size;
+	}
+
+	// 2x2 box filter of RGBA8 image.
+	std::vector<unsigned char> Downsample(const std::vector<unsigned char>& Level, int& Width, int& Height)
+	{
+		const int NewWidth = std::max(1, Width / 2);
+		const int NewHeight = std::max(1, Height / 2);
+
+		std::vector<unsigned char> NewLevel(size_t(NewWidth) * NewHeight * 4);
+		for (int y = 0; y < NewHeight; ++y)
+		{
+			for (int x = 0; x < NewWidth; ++x)
+			{
+				const int x0 = std::min(x * 2, Width - 1);
+				const int x1 = std::min(x * 2 + 1, Width - 1);
+				const int y0 = std::min(y * 2, Height - 1);
+				const int y1 = std::min(y * 2 + 1, Height - 1);
+
+				for (int c = 0; c < 4; ++c)
+				{
+					const int Sum =
+						Level[(size_t(y0) * Width + x0) * 4 + c] +
+						Level[(size_t(y0) * Width + x1) * 4 + c] +
+						Level[(size_t(y1) * Width + x0) * 4 + c] +
+						Level[(size_t(y1) * Width + x1) * 4 + c];
+
+					NewLevel[(size_t(y) * NewWidth + x) * 4 + c] = static_cast<unsigned char>((Sum + 2) / 4);
+				}
+			}
+		}
+
+		Width = NewWidth;
+		Height = NewHeight;
+		return NewLevel;
+	}
+}
+
+// FVirtualTexture
+
+bool FVirtualTexture::Init(const char* file_name, ETextureColorSpace ColorSpace)
+{
+	CachePath = std::string(file_name) + ".vt";
+
+	uint64_t SourceTime = 0;
+	uint64_t SourceSize = 0;
+	GetFileStamp(file_name, SourceTime, SourceSize);
+
+	FVirtualTextureHeader Header;
+	std::ifstream File(CachePath, std::ios::binary);
+	if (!File || !File.read((char*)&Header, sizeof(Header)) || !IsValidHeader(Header, SourceTime, SourceSize))
+	{
+		File.close();
+
+		if (!BuildCache(file_name, CachePath, SourceTime, SourceSize))
+		{
+			return false;
+		}
+
+		File.clear();
+		File.open(CachePath, std::ios::binary);
+		if (!File || !File.read((char*)&Header, sizeof(Header)) || !IsValidHeader(Header, SourceTime, SourceSize))
+		{
+			std::cout << "Virtual texture cache failed to load at path: " << CachePath << std::endl;
+			return false;
+		}
+	}
+
+	Width = static_cast<int>(Header.Width);
+	Height = static_cast<int>(Header.Height);
+
+	const glm::ivec2 Pages = GetPagesNum(0);
+	MipCount = 1;
+	while ((std::max(Pages.x, Pages.y) >> MipCount) > 0)
+	{
+		++MipCount;
+	}
+
+	MipOffsets.clear();
+	PageTable.clear();
+	size_t Offset = 0;
+	for (int Mip = 0; Mip < MipCount; ++Mip)
+	{
+		const glm::ivec2 MipPages = GetPagesNum(Mip);
+		MipOffsets.push_back(Offset);
+		Offset += size_t(MipPages.x) * MipPages.y;
+		PageTable.emplace_back(size_t(MipPages.x) * MipPages.y * 4, 0);
+	}
+
+	glGenTextures(1, &PageTableID);
+	FStateCache::Get().BindTexture(GL_TEXTURE_2D, PageTableID);
+	for (int Mip = 0; Mip < MipCount; ++Mip)
+	{
+		const glm::ivec2 MipPages = GetPagesNum(Mip);
+		glTexImage2D(GL_TEXTURE_2D, Mip, GL_RGBA8, MipPages.x, MipPages.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, MipCount - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	const int AtlasSize = VT_ATLAS_PAGES * PageTexels;
+	const GLenum InternalFormat = ColorSpace == ETextureColorSpace::ESRGB ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+
+	glGenTextures(1, &AtlasID);
+	FStateCache::Get().BindTexture(GL_TEXTURE_2D, AtlasID);
+	glTexImage2D(GL_TEXTURE_2D, 0, InternalFormat, AtlasSize, AtlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// Coarsest mip stays resident, so every page table entry points to some page.
+	std::vector<unsigned char> Texels;
+	const glm::ivec2 CoarsestPages = GetPagesNum(MipCount - 1);
+	for (int y = 0; y < CoarsestPages.y; ++y)
+	{
+		for (int x = 0; x < CoarsestPages.x; ++x)
+		{
+			FVirtualPage Page;
+			Page.Mip = MipCount - 1;
+			Page.X = x;
+			Page.Y = y;
+
+			if (!ReadPage(File, Page, Texels) || !UploadPage(Page, Texels, 0, true))
+			{
+				std::cout << "Virtual texture cache failed to load at path: " << CachePath << std::endl;
+				return false;
+			}
+		}
+	}
+
+	UpdatePageTable();
+
+	return true;
+}
+
+void FVirtualTexture::Shutdown()
+{
+	for (GLuint* Texture : { &PageTableID, &AtlasID })
+	{
+		if (*Texture)
+		{
+			FStateCache::Get().DeleteTextures(1, Texture);
+			*Texture = 0;
+		}
+	}
+
+	Slots.fill(FPhysicalSlot());
+	ResidentPages.clear();
+	PendingPages.clear();
+	FailedPages.clear();
+	bPageTableDirty = true;
+}
+
+bool FVirtualTexture::BuildCache(const char* file_name, const std::string& inCachePath, uint64_t SourceTime, uint64_t SourceSize)
+{
+	int ImageWidth, ImageHeight, Components;
+	unsigned char* Data = stbi_load(file_name, &ImageWidth, &ImageHeight, &Components, 4);
+	if (!Data)
+	{
+		std::cout << "Texture failed to load at path: " << file_name << std::endl;
+		return false;
+	}
+
+	if ((ImageWidth & (ImageWidth - 1)) != 0 || (ImageHeight & (ImageHeight - 1)) != 0)
+	{
+		std::cout << "Virtual texture has to be power of two size: " << file_name << std::endl;
+		stbi_image_free(Data);
+		return false;
+	}
+
+	std::vector<unsigned char> Level(Data, Data + size_t(ImageWidth) * ImageHeight * 4);
+	stbi_image_free(Data);
+
+	std::ofstream File(inCachePath, std::ios::binary | std::ios::trunc);
+	if (!File)
+	{
+		std::cout << "Unable to open " << inCachePath << " for writing" << std::endl;
+		return false;
+	}
+
+	FVirtualTextureHeader Header;
+	Header.Width = ImageWidth;
+	Header.Height = ImageHeight;
+	Header.SourceTime = SourceTime;
+	Header.SourceSize = SourceSize;
+	File.write((const char*)&Header, sizeof(Header));
+
+	int LevelWidth = ImageWidth;
+	int LevelHeight = ImageHeight;
+	int PagesX = std::max(1, ImageWidth / VT_PAGE_SIZE);
+	int PagesY = std::max(1, ImageHeight / VT_PAGE_SIZE);
+
+	std::vector<unsigned char> Page(PageBytes);
+	while (true)
+	{
+		for (int py = 0; py < PagesY; ++py)
+		{
+			for (int px = 0; px < PagesX; ++px)
+			{
+				// Border texels are wrapped like GL_REPEAT, so filtering across pages has no seams.
+				for (int ty = 0; ty < PageTexels; ++ty)
+				{
+					const int sy = Wrap(py * VT_PAGE_SIZE + ty - VT_PAGE_BORDER, LevelHeight);
+					for (int tx = 0; tx < PageTexels; ++tx)
+					{
+						const int sx = Wrap(px * VT_PAGE_SIZE + tx - VT_PAGE_BORDER, LevelWidth);
+						memcpy(&Page[(size_t(ty) * PageTexels + tx) * 4], &Level[(size_t(sy) * LevelWidth + sx) * 4], 4);
+					}
+				}
+
+				File.write((const char*)Page.data(), Page.size());
+			}
+		}
+
+		if (PagesX == 1 && PagesY == 1)
+		{
+			break;
+		}
+
+		Level = Downsample(Level, LevelWidth, LevelHeight);
+		PagesX = std::max(1, PagesX / 2);
+		PagesY = std::max(1, PagesY / 2);
+	}
+
+	if (!File)
+	{
+		std::cout << "Unable to write virtual texture cache " << inCachePath << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool FVirtualTexture::ReadPage(std::istream& File, const FVirtualPage& Page, std::vector<unsigned char>& Texels) const
+{
+	const glm::ivec2 Pages = GetPagesNum(Page.Mip);
+	const size_t Index = MipOffsets[Page.Mip] + size_t(Page.Y) * Pages.x + Page.X;
+
+	Texels.resize(PageBytes);
+
+	File.clear();
+	File.seekg(sizeof(FVirtualTextureHeader) + Index * PageBytes);
+	File.read((char*)Texels.data(), PageBytes);
+
+	return bool(File);
+}
+
+glm::ivec2 FVirtualTexture::GetPagesNum(int Mip) const
+{
+	return glm::ivec2(
+		std::max(1, std::max(1, Width / VT_PAGE_SIZE) >> Mip),
+		std::max(1, std::max(1, Height / VT_PAGE_SIZE) >> Mip));
+}
+
+uint32_t FVirtualTexture::GetKey(const FVirtualPage& Page)
+{
+	return (uint32_t(Page.Mip) << 24) | (uint32_t(Page.Y) << 12) | uint32_t(Page.X);
+}
+
+FVirtualPage FVirtualTexture::GetPage(uint32_t Key)
+{
+	FVirtualPage Page;
+	Page.Mip = int(Key >> 24);
+	Page.Y = int((Key >> 12) & 0xFFF);
+	Page.X = int(Key & 0xFFF);
+	return Page;
+}
+
+uint32_t FVirtualTexture::GetPageKey(glm::vec2 UV, float Lod) const
+{
+	FVirtualPage Page;
+	Page.Mip = glm::clamp(int(std::floor(Lod + std::log2(float(std::max(Width, Height))))), 0, MipCount - 1);
+
+	const glm::ivec2 Pages = GetPagesNum(Page.Mip);
+	UV = glm::fract(UV);
+	Page.X = glm::clamp(int(UV.x * Pages.x), 0, Pages.x - 1);
+	Page.Y = glm::clamp(int(UV.y * Pages.y), 0, Pages.y - 1);
+
+	return GetKey(Page);
+}
+
+bool FVirtualTexture::Touch(uint32_t Key, uint64_t Frame)
+{
+	const auto Found = ResidentPages.find(Key);
+	if (Found == ResidentPages.end())
+	{
+		return false;
+	}
+
+	Slots[Found->second].LastUsed = Frame;
+	return true;
+}
+
+int FVirtualTexture::GetAvailableSlots(uint64_t Frame) const
+{
+	// Same rule as eviction in UploadPage.
+	return static_cast<int>(std::count_if(Slots.begin(), Slots.end(), [Frame](const FPhysicalSlot& Slot)
+	{
+		return !Slot.bUsed || (!Slot.bPinned && Slot.LastUsed + 1 < Frame);
+	}));
+}
+
+bool FVirtualTexture::UploadPage(const FVirtualPage& Page, const std::vector<unsigned char>& Texels, uint64_t Frame, bool bPinned)
+{
+	const uint32_t Key = GetKey(Page);
+	if (ResidentPages.count(Key))
+	{
+		return true;
+	}
+
+	int Slot = -1;
+	for (int i = 0; i < static_cast<int>(Slots.size()); ++i)
+	{
+		if (!Slots[i].bUsed)
+		{
+			Slot = i;
+			break;
+		}
+	}
+
+	// Evict least recently used page, pages seen by the latest feedback stay resident.
+	if (Slot < 0)
+	{
+		for (int i = 0; i < static_cast<int>(Slots.size()); ++i)
+		{
+			if (Slots[i].bPinned || Slots[i].LastUsed + 1 >= Frame)
+			{
+				continue;
+			}
+			if (Slot < 0 || Slots[i].LastUsed < Slots[Slot].LastUsed)
+			{
+				Slot = i;
+			}
+		}
+	}
+
+	if (Slot < 0)
+	{
+		return false;
+	}
+
+	if (Slots[Slot].bUsed)
+	{
+		ResidentPages.erase(Slots[Slot].Key);
+	}
+
+	FStateCache::Get().BindTexture(GL_TEXTURE_2D, AtlasID);
+	glTexSubImage2D(GL_TEXTURE_2D, 0,
+		(Slot % VT_ATLAS_PAGES) * PageTexels, (Slot / VT_ATLAS_PAGES) * PageTexels,
+		PageTexels, PageTexels, GL_RGBA, GL_UNSIGNED_BYTE, Texels.data());
+
+	Slots[Slot].Key = Key;
+	Slots[Slot].LastUsed = Frame;
+	Slots[Slot].bUsed = true;
+	Slots[Slot].bPinned = bPinned;
+
+	ResidentPages[Key] = Slot;
+	bPageTableDirty = true;
+
+	return true;
+}
+
+void FVirtualTexture::UpdatePageTable()
+{
+	if (!bPageTableDirty)
+	{
+		return;
+	}
+
+	FStateCache::Get().BindTexture(GL_TEXTURE_2D, PageTableID);
+
+	// From coarsest to finest, missing pages inherit the entry of the parent page.
+	for (int Mip = MipCount - 1; Mip >= 0; --Mip)
+	{
+		const glm::ivec2 Pages = GetPagesNum(Mip);
+		std::vector<unsigned char>& Table = PageTable[Mip];
+
+		for (int y = 0; y < Pages.y; ++y)
+		{
+			for (int x = 0; x < Pages.x; ++x)
+			{
+				FVirtualPage Page;
+				Page.Mip = Mip;
+				Page.X = x;
+				Page.Y = y;
+
+				unsigned char* Entry = &Table[(size_t(y) * Pages.x + x) * 4];
+
+				const auto Found = ResidentPages.find(GetKey(Page));
+				if (Found != ResidentPages.end())
+				{
+					Entry[0] = static_cast<unsigned char>(Found->second % VT_ATLAS_PAGES);
+					Entry[1] = static_cast<unsigned char>(Found->second / VT_ATLAS_PAGES);
+					Entry[2] = static_cast<unsigned char>(Mip);
+					Entry[3] = 255;
+				}
+				else if (Mip < MipCount - 1)
+				{
+					const glm::ivec2 ParentPages = GetPagesNum(Mip + 1);
+					memcpy(Entry, &PageTable[Mip + 1][(size_t(y >> 1) * ParentPages.x + (x >> 1)) * 4], 4);
+				}
+			}
+		}
+
+		glTexSubImage2D(GL_TEXTURE_2D, Mip, 0, 0, Pages.x, Pages.y, GL_RGBA, GL_UNSIGNED_BYTE, Table.data());
+	}
+
+	bPageTableDirty = false;
+}
+
+// FVirtualTextureSystem
+
+FVirtualTextureSystem::FVirtualTextureSystem()
+	:FeedbackShader("Virtual Texture Feedback", "Source/Shaders/_vs.glsl", "Source/Shaders/vt_feedback_fs.glsl")
+{
+
+}
+
+FVirtualTextureSystem::~FVirtualTextureSystem()
+{
+	Shutdown();
+}
+
+bool FVirtualTextureSystem::Init(const std::array<const char*, 4>& FileNames, int ScreenWidth, int ScreenHeight)
+{
+	Textures.clear();
+	Textures.resize(FileNames.size());
+	for (size_t i = 0; i < FileNames.size(); ++i)
+	{
+		// Albedo is the only color texture.
+		if (!Textures[i].Init(FileNames[i], i == 0 ? ETextureColorSpace::ESRGB : ETextureColorSpace::ELinear))
+		{
+			Shutdown();
+			return false;
+		}
+	}
+
+	FeedbackShader.Init();
+
+	if (!CreateFeedbackTargets(ScreenWidth, ScreenHeight))
+	{
+		Shutdown();
+		return false;
+	}
+
+	bStop = false;
+	Streamer = std::thread(&FVirtualTextureSystem::StreamPages, this);
+
+	bInitialized = true;
+
+	return true;
+}
+
+bool FVirtualTextureSystem::CreateFeedbackTargets(int ScreenWidth, int ScreenHeight)
+{
+	FeedbackWidth = std::max(1, ScreenWidth / VT_FEEDBACK_DIVISOR);
+	FeedbackHeight = std::max(1, ScreenHeight / VT_FEEDBACK_DIVISOR);
+	bPreviousFeedback = false;
+
+	glGenTextures(1, &FeedbackColor);
+	FStateCache::Get().BindTexture(GL_TEXTURE_2D, FeedbackColor);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, FeedbackWidth, FeedbackHeight, 0, GL_RGBA, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenRenderbuffers(1, &FeedbackDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, FeedbackDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, FeedbackWidth, FeedbackHeight);
+
+	glGenFramebuffers(1, &FeedbackFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FeedbackFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, FeedbackColor, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, FeedbackDepth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Virtual texture feedback framebuffer is not complete" << std::endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		DeleteFeedbackTargets();
+		return false;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenBuffers(2, FeedbackPBOs.data());
+	for (GLuint PBO : FeedbackPBOs)
+	{
+		FStateCache::Get().BindBuffer(GL_PIXEL_PACK_BUFFER, PBO);
+		glBufferData(GL_PIXEL_PACK_BUFFER, size_t(FeedbackWidth) * FeedbackHeight * 4 * sizeof(float), nullptr, GL_STREAM_READ);
+	}
+	FStateCache::Get().BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	return true;
+}
+
+void FVirtualTextureSystem::DeleteFeedbackTargets()
+{
+	if (FeedbackFBO)
+	{
+		glDeleteFramebuffers(1, &FeedbackFBO);
+		FeedbackFBO = 0;
+	}
+	if (FeedbackColor)
+	{
+		FStateCache::Get().DeleteTextures(1, &FeedbackColor);
+		FeedbackColor = 0;
+	}
+	if (FeedbackDepth)
+	{
+		glDeleteRenderbuffers(1, &FeedbackDepth);
+		FeedbackDepth = 0;
+	}
+	if (FeedbackPBOs[0])
+	{
+		FStateCache::Get().DeleteBuffers(2, FeedbackPBOs.data());
+		FeedbackPBOs = { 0, 0 };
+	}
+
+	FeedbackWidth = 0;
+	FeedbackHeight = 0;
+	bPreviousFeedback = false;
+}
+
+void FVirtualTextureSystem::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		bStop = true;
+	}
+	Condition.notify_all();
+
+	if (Streamer.joinable())
+	{
+		Streamer.join();
+	}
+
+	Requests.clear();
+	LoadedPages.clear();
+
+	for (FVirtualTexture& Texture : Textures)
+	{
+		Texture.Shutdown();
+	}
+	Textures.clear();
+
+	DeleteFeedbackTargets();
+	FeedbackShader.Release();
+
+	Frame = 0;
+	bInitialized = false;
+}
+
+FShader* FVirtualTextureSystem::BeginFeedback(int ScreenWidth, int ScreenHeight)
+{
+	if (std::max(1, ScreenWidth / VT_FEEDBACK_DIVISOR) != FeedbackWidth ||
+		std::max(1, ScreenHeight / VT_FEEDBACK_DIVISOR) != FeedbackHeight)
+	{
+		DeleteFeedbackTargets();
+		if (!CreateFeedbackTargets(ScreenWidth, ScreenHeight))
+		{
+			return nullptr;
+		}
+	}
+
+	glGetIntegerv(GL_VIEWPORT, SavedViewport);
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &SavedFramebuffer);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, FeedbackFBO);
+	glViewport(0, 0, FeedbackWidth, FeedbackHeight);
+	glClearColor(0.f, 0.f, 0.f, 0.f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	FeedbackShader.Use();
+	FeedbackShader.SetFloat("FeedbackDivisor", float(VT_FEEDBACK_DIVISOR));
+
+	return &FeedbackShader;
+}
+
+void FVirtualTextureSystem::EndFeedback()
+{
+	const size_t Size = size_t(FeedbackWidth) * FeedbackHeight * 4 * sizeof(float);
+	const size_t Current = Frame % 2;
+
+	// Read back into PBO and process it in the next frame, so the readback does not stall.
+	FStateCache::Get().BindBuffer(GL_PIXEL_PACK_BUFFER, FeedbackPBOs[Current]);
+	glReadPixels(0, 0, FeedbackWidth, FeedbackHeight, GL_RGBA, GL_FLOAT, nullptr);
+
+	if (bPreviousFeedback)
+	{
+		FStateCache::Get().BindBuffer(GL_PIXEL_PACK_BUFFER, FeedbackPBOs[1 - Current]);
+		const float* Pixels = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, Size, GL_MAP_READ_BIT);
+		if (Pixels)
+		{
+			ProcessFeedback(Pixels);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+	}
+	bPreviousFeedback = true;
+
+	FStateCache::Get().BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, SavedFramebuffer);
+	glViewport(SavedViewport[0], SavedViewport[1], SavedViewport[2], SavedViewport[3]);
+
+	++Frame;
+}
+
+void FVirtualTextureSystem::ProcessFeedback(const float* Pixels)
+{
+	std::vector<std::unordered_set<uint32_t>> Visible(Textures.size());
+
+	for (int i = 0; i < FeedbackWidth * FeedbackHeight; ++i)
+	{
+		const float* Pixel = Pixels + size_t(i) * 4;
+
+		// Alpha is zero where no textured geometry was drawn.
+		if (Pixel[3] == 0.f)
+		{
+			continue;
+		}
+
+		for (size_t t = 0; t < Textures.size(); ++t)
+		{
+			Visible[t].insert(Textures[t].GetPageKey(glm::vec2(Pixel[0], Pixel[1]), Pixel[2]));
+		}
+	}
+
+	bool bRequested = false;
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		std::vector<uint32_t> Missing;
+		for (size_t t = 0; t < Textures.size(); ++t)
+		{
+			Missing.clear();
+			for (uint32_t Key : Visible[t])
+			{
+				if (!Textures[t].Touch(Key, Frame) && !Textures[t].PendingPages.count(Key) && !Textures[t].FailedPages.count(Key))
+				{
+					Missing.push_back(Key);
+				}
+			}
+
+			// Only pages the atlas has room for are read, the rest would be dropped on upload and requested
+			// again every frame. Coarser mips (higher keys) go first, so all visible areas get some detail.
+			const int Budget = Textures[t].GetAvailableSlots(Frame + 1) - static_cast<int>(Textures[t].PendingPages.size());
+			const size_t Count = std::min(Missing.size(), size_t(std::max(Budget, 0)));
+			std::partial_sort(Missing.begin(), Missing.begin() + Count, Missing.end(), std::greater<uint32_t>());
+
+			for (size_t i = 0; i < Count; ++i)
+			{
+				FVirtualPage Page = FVirtualTexture::GetPage(Missing[i]);
+				Page.Texture = static_cast<int>(t);
+
+				Requests.push_back(Page);
+				Textures[t].PendingPages.insert(Missing[i]);
+				bRequested = true;
+			}
+		}
+	}
+
+	if (bRequested)
+	{
+		Condition.notify_one();
+	}
+}
+
+void FVirtualTextureSystem::Update()
+{
+	std::vector<FLoadedPage> Pages;
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		while (!LoadedPages.empty() && Pages.size() < VT_MAX_UPLOADS)
+		{
+			Pages.push_back(std::move(LoadedPages.front()));
+			LoadedPages.pop_front();
+		}
+	}
+
+	std::vector<FLoadedPage> Retries;
+	for (FLoadedPage& Loaded : Pages)
+	{
+		FVirtualTexture& Texture = Textures[Loaded.Page.Texture];
+		const uint32_t Key = FVirtualTexture::GetKey(Loaded.Page);
+
+		// Read failed, e.g. truncated cache file. Requesting the page again would fail the same way every frame.
+		if (Loaded.Texels.empty())
+		{
+			Texture.PendingPages.erase(Key);
+			Texture.FailedPages.insert(Key);
+			std::cout << "Virtual texture page " << Key << " failed to read from " << Texture.GetCachePath() << std::endl;
+			continue;
+		}
+
+		// Every slot holds a page seen by the latest feedback, the slots budgeted for the request were taken
+		// by pages uploaded meanwhile. Page stays pending and waits for a free slot instead of being read again.
+		if (!Texture.UploadPage(Loaded.Page, Loaded.Texels, Frame))
+		{
+			Retries.push_back(std::move(Loaded));
+			continue;
+		}
+
+		Texture.PendingPages.erase(Key);
+	}
+
+	if (!Retries.empty())
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		LoadedPages.insert(LoadedPages.begin(), std::make_move_iterator(Retries.begin()), std::make_move_iterator(Retries.end()));
+	}
+
+	for (FVirtualTexture& Texture : Textures)
+	{
+		Texture.UpdatePageTable();
+	}
+}
+
+void FVirtualTextureSystem::Bind(FShader& Shader) const
+{
+	for (size_t i = 0; i < Textures.size(); ++i)
+	{
+		const std::string Index = "[" + std::to_string(i) + "]";
+		const int PageTableUnit = 4 + static_cast<int>(i);
+		const int AtlasUnit = 8 + static_cast<int>(i);
+
+		FStateCache::Get().BindTexture(PageTableUnit, GL_TEXTURE_2D, Textures[i].GetPageTableID());
+		FStateCache::Get().BindTexture(AtlasUnit, GL_TEXTURE_2D, Textures[i].GetAtlasID());
+
+		Shader.SetInt("PageTables" + Index, PageTableUnit);
+		Shader.SetInt("PhysicalPages" + Index, AtlasUnit);
+		Shader.SetVec3("VirtualSizes" + Index, Textures[i].GetVirtualSize());
+	}
+}
+
+int FVirtualTextureSystem::GetResidentPages() const
+{
+	int Pages = 0;
+	for (const FVirtualTexture& Texture : Textures)
+	{
+		Pages += Texture.GetResidentPages();
+	}
+	return Pages;
+}
+
+int FVirtualTextureSystem::GetCapacity() const
+{
+	return static_cast<int>(Textures.size()) * VT_ATLAS_PAGES * VT_ATLAS_PAGES;
+}
+
+size_t FVirtualTextureSystem::GetPendingPages() const
+{
+	size_t Pages = 0;
+	for (const FVirtualTexture& Texture : Textures)
+	{
+		Pages += Texture.PendingPages.size();
+	}
+	return Pages;
+}
+
+void FVirtualTextureSystem::StreamPages()
+{
+	CPU_THREAD_NAME("Virtual Texture Streaming");
+
+	// Streaming thread has its own file handles, texture headers are not modified after Init.
+	std::vector<std::ifstream> Files;
+	for (const FVirtualTexture& Texture : Textures)
+	{
+		Files.emplace_back(Texture.GetCachePath(), std::ios::binary);
+	}
+
+	while (true)
+	{
+		FLoadedPage Loaded;
+		{
+			std::unique_lock<std::mutex> Lock(Mutex);
+			Condition.wait(Lock, [this] { return bStop || !Requests.empty(); });
+
+			if (bStop)
+			{
+				return;
+			}
+
+			Loaded.Page = Requests.front();
+			Requests.pop_front();
+		}
+
+		{
+			CPU_SCOPE("ReadPage");
+			if (!Textures[Loaded.Page.Texture].ReadPage(Files[Loaded.Page.Texture], Loaded.Page, Loaded.Texels))
+			{
+				Loaded.Texels.clear();
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			LoadedPages.push_back(std::move(Loaded));
+		}
+	}
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "glm/glm.hpp"
+
+#include "Texture/Texture.h"
+#include "Shaders/Shader.h"
+
+// Must match constants in textured shaders.
+#define VT_PAGE_SIZE 128
+#define VT_PAGE_BORDER 4
+// Physical atlas holds VT_ATLAS_PAGES x VT_ATLAS_PAGES pages.
+#define VT_ATLAS_PAGES 16
+// Feedback pass is rendered at 1 / VT_FEEDBACK_DIVISOR of the screen resolution.
+#define VT_FEEDBACK_DIVISOR 8
+// Pages uploaded to the atlas per frame.
+#define VT_MAX_UPLOADS 16
+
+struct FVirtualPage
+{
+	int Texture = 0;
+	int Mip = 0;
+	int X = 0;
+	int Y = 0;
+};
+
+struct FLoadedPage
+{
+	FVirtualPage Page;
+	std::vector<unsigned char> Texels;
+};
+
+// Single virtual texture.
+// Image is split into pages stored in tiled cache file on disk (built from source image on first use
+// and again whenever the image changes),
+// only the pages requested by the feedback pass live in the physical atlas.
+// Page table (indirection texture) maps every virtual page to the finest resident page covering it.
+class FVirtualTexture
+{
+public:
+
+	bool Init(const char* file_name, ETextureColorSpace ColorSpace);
+	// Deletes the page table and the atlas.
+	void Shutdown();
+
+	// Reads texels of the page from the cache file, safe to call from the streaming thread.
+	bool ReadPage(std::istream& File, const FVirtualPage& Page, std::vector<unsigned char>& Texels) const;
+
+	// Returns key of the page sampled with given uv and lod (log2 of uv units per pixel).
+	uint32_t GetPageKey(glm::vec2 UV, float Lod) const;
+
+	// Marks page as used in this frame, returns false if it is not resident.
+	bool Touch(uint32_t Key, uint64_t Frame);
+	// Slots an upload in given frame may use, free ones or ones holding pages not seen since the frame before.
+	int GetAvailableSlots(uint64_t Frame) const;
+
+	bool UploadPage(const FVirtualPage& Page, const std::vector<unsigned char>& Texels, uint64_t Frame, bool bPinned = false);
+	void UpdatePageTable();
+
+	const std::string& GetCachePath() const { return CachePath; };
+	glm::vec3 GetVirtualSize() const { return glm::vec3(Width, Height, MipCount); };
+	GLuint GetPageTableID() const { return PageTableID; };
+	GLuint GetAtlasID() const { return AtlasID; };
+	int GetResidentPages() const { return static_cast<int>(ResidentPages.size()); };
+
+	static uint32_t GetKey(const FVirtualPage& Page);
+	static FVirtualPage GetPage(uint32_t Key);
+
+	// Pages requested from the streaming thread and not uploaded yet.
+	std::unordered_set<uint32_t> PendingPages;
+	// Pages the cache file could not be read for, never requested again. The parent mip is shown instead.
+	std::unordered_set<uint32_t> FailedPages;
+
+private:
+
+	struct FPhysicalSlot
+	{
+		uint32_t Key = 0;
+		uint64_t LastUsed = 0;
+		bool bUsed = false;
+		bool bPinned = false;
+	};
+
+	// Splits image into pages with borders, generating mips on CPU. Source stamp is stored in the header.
+	static bool BuildCache(const char* file_name, const std::string& inCachePath, uint64_t SourceTime, uint64_t SourceSize);
+
+	glm::ivec2 GetPagesNum(int Mip) const;
+
+	std::string CachePath;
+
+	int Width = 0;
+	int Height = 0;
+	int MipCount = 0;
+	// Offsets (in pages) of every mip level in the cache file.
+	std::vector<size_t> MipOffsets;
+
+	GLuint PageTableID = 0;
+	GLuint AtlasID = 0;
+
+	std::array<FPhysicalSlot, VT_ATLAS_PAGES * VT_ATLAS_PAGES> Slots;
+	std::unordered_map<uint32_t, int> ResidentPages;
+
+	// RGBA8 page table per mip : atlas x, atlas y, mip of resident page.
+	std::vector<std::vector<unsigned char>> PageTable;
+	bool bPageTableDirty = true;
+};
+
+// Set of virtual textures of the material with feedback pass and background streaming thread.
+class FVirtualTextureSystem
+{
+public:
+
+	FVirtualTextureSystem();
+	~FVirtualTextureSystem();
+
+	// Albedo, Normal, Metallic, Roughness.
+	bool Init(const std::array<const char*, 4>& FileNames, int ScreenWidth, int ScreenHeight);
+	// Stops streaming and deletes every GL object, Init may be called again.
+	void Shutdown();
+
+	bool IsInitialized() const { return bInitialized; };
+
+	// Binds low resolution feedback framebuffer, resized to follow the screen, returned shader has to be used
+	// to draw the textured geometry. Null if the framebuffer could not be created, EndFeedback must not be called then.
+	FShader* BeginFeedback(int ScreenWidth, int ScreenHeight);
+	// Reads feedback of the previous frame and requests missing pages.
+	void EndFeedback();
+
+	// Uploads streamed pages to the atlases and refreshes page tables.
+	void Update();
+
+	// Binds page tables and atlases after the regular material textures.
+	void Bind(FShader& Shader) const;
+
+	FShader& GetFeedbackShader() { return FeedbackShader; };
+
+	int GetResidentPages() const;
+	int GetCapacity() const;
+	size_t GetPendingPages() const;
+
+private:
+
+	void StreamPages();
+	void ProcessFeedback(const float* Pixels);
+
+	bool CreateFeedbackTargets(int ScreenWidth, int ScreenHeight);
+	void DeleteFeedbackTargets();
+
+	std::vector<FVirtualTexture> Textures;
+
+	FShader FeedbackShader;
+
+	GLuint FeedbackFBO = 0;
+	GLuint FeedbackColor = 0;
+	GLuint FeedbackDepth = 0;
+	std::array<GLuint, 2> FeedbackPBOs = { 0, 0 };
+	int FeedbackWidth = 0;
+	int FeedbackHeight = 0;
+	// Other PBO holds feedback of the previous frame at the current size.
+	bool bPreviousFeedback = false;
+	GLint SavedViewport[4] = { 0, 0, 0, 0 };
+	// Scene may be rendered offscreen.
+	GLint SavedFramebuffer = 0;
+
+	uint64_t Frame = 0;
+
+	bool bInitialized = false;
+
+	std::thread Streamer;
+	std::mutex Mutex;
+	std::condition_variable Condition;
+	std::deque<FVirtualPage> Requests;
+	std::deque<FLoadedPage> LoadedPages;
+	bool bStop = false;
+};
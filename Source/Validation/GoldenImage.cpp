@@ -0,0 +1,319 @@
+#include "GoldenImage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Standard deviation in pixels of the blur applied before the perceptual comparison.
+#define GOLDEN_BLUR_SIGMA 1.f
+// HyAB distance mapped to the full perceptual error.
+#define GOLDEN_HYAB_RANGE 100.f
+
+namespace
+{
+	void MakeDirectory(const std::string& Path)
+	{
+#ifdef _WIN32
+		_mkdir(Path.c_str());
+#else
+		mkdir(Path.c_str(), 0755);
+#endif
+	}
+
+	float LinearToSRGB(float Value)
+	{
+		Value = std::max(0.f, std::min(Value, 1.f));
+		return Value <= 0.0031308f ? Value * 12.92f : 1.055f * std::pow(Value, 1.f / 2.4f) - 0.055f;
+	}
+
+	float SRGBToLinear(float Value)
+	{
+		Value = std::max(0.f, std::min(Value, 1.f));
+		return Value <= 0.04045f ? Value / 12.92f : std::pow((Value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float LabCurve(float Value)
+	{
+		return Value > 0.008856f ? std::cbrt(Value) : 7.787f * Value + 16.f / 116.f;
+	}
+
+	// Separable gaussian blur of interleaved channels.
+	std::vector<float> Blur(const std::vector<float>& Source, int Width, int Height, int Channels)
+	{
+		const int Radius = int(std::ceil(3.f * GOLDEN_BLUR_SIGMA));
+		std::vector<float> Kernel(2 * Radius + 1);
+		float Sum = 0.f;
+		for (int i = -Radius; i <= Radius; ++i)
+		{
+			Kernel[i + Radius] = std::exp(-0.5f * i * i / (GOLDEN_BLUR_SIGMA * GOLDEN_BLUR_SIGMA));
+			Sum += Kernel[i + Radius];
+		}
+		for (float& Weight : Kernel)
+		{
+			Weight /= Sum;
+		}
+
+		std::vector<float> Horizontal(Source.size(), 0.f);
+		std::vector<float> Result(Source.size(), 0.f);
+		for (int y = 0; y < Height; ++y)
+		{
+			for (int x = 0; x < Width; ++x)
+			{
+				for (int i = -Radius; i <= Radius; ++i)
+				{
+					const int Sample = std::max(0, std::min(x + i, Width - 1));
+					for (int c = 0; c < Channels; ++c)
+					{
+						Horizontal[(size_t(y) * Width + x) * Channels + c] += Kernel[i + Radius] * Source[(size_t(y) * Width + Sample) * Channels + c];
+					}
+				}
+			}
+		}
+		for (int y = 0; y < Height; ++y)
+		{
+			for (int x = 0; x < Width; ++x)
+			{
+				for (int i = -Radius; i <= Radius; ++i)
+				{
+					const int Sample = std::max(0, std::min(y + i, Height - 1));
+					for (int c = 0; c < Channels; ++c)
+					{
+						Result[(size_t(y) * Width + x) * Channels + c] += Kernel[i + Radius] * Horizontal[(size_t(Sample) * Width + x) * Channels + c];
+					}
+				}
+			}
+		}
+		return Result;
+	}
+
+	// Blurred L*a*b* of the displayed image.
+	std::vector<float> ToLab(const FImage& Image)
+	{
+		std::vector<float> Linear(Image.Pixels.size());
+		std::transform(Image.Pixels.begin(), Image.Pixels.end(), Linear.begin(), SRGBToLinear);
+
+		std::vector<float> Lab = Blur(Linear, Image.Width, Image.Height, 3);
+		for (size_t i = 0; i < Lab.size(); i += 3)
+		{
+			const float R = Lab[i], G = Lab[i + 1], B = Lab[i + 2];
+			// sRGB to XYZ relative to D65 white.
+			const float X = LabCurve((0.4124f * R + 0.3576f * G + 0.1805f * B) / 0.95047f);
+			const float Y = LabCurve(0.2126f * R + 0.7152f * G + 0.0722f * B);
+			const float Z = LabCurve((0.0193f * R + 0.1192f * G + 0.9505f * B) / 1.08883f);
+			Lab[i] = 116.f * Y - 16.f;
+			Lab[i + 1] = 500.f * (X - Y);
+			Lab[i + 2] = 200.f * (Y - Z);
+		}
+		return Lab;
+	}
+
+	// Sobel gradient magnitude of lightness in 0 - 1 range.
+	float GetEdge(const std::vector<float>& Lab, int Width, int Height, int x, int y)
+	{
+		auto L = [&](int sx, int sy)
+		{
+			sx = std::max(0, std::min(sx, Width - 1));
+			sy = std::max(0, std::min(sy, Height - 1));
+			return Lab[(size_t(sy) * Width + sx) * 3] / 100.f;
+		};
+		const float Gx = L(x + 1, y - 1) + 2.f * L(x + 1, y) + L(x + 1, y + 1) - L(x - 1, y - 1) - 2.f * L(x - 1, y) - L(x - 1, y + 1);
+		const float Gy = L(x - 1, y + 1) + 2.f * L(x, y + 1) + L(x + 1, y + 1) - L(x - 1, y - 1) - 2.f * L(x, y - 1) - L(x + 1, y - 1);
+		return std::min(std::sqrt(Gx * Gx + Gy * Gy) / 4.f, 1.f);
+	}
+}
+
+FImage FImage::FromFramebuffer(int inWidth, int inHeight, const std::vector<float>& RGBA, bool bLinear)
+{
+	FImage Image;
+	Image.Width = inWidth;
+	Image.Height = inHeight;
+	Image.Pixels.resize(size_t(inWidth) * inHeight * 3);
+
+	for (size_t i = 0; i < size_t(inWidth) * inHeight; ++i)
+	{
+		for (size_t c = 0; c < 3; ++c)
+		{
+			const float Value = RGBA[i * 4 + c];
+			Image.Pixels[i * 3 + c] = bLinear ? LinearToSRGB(Value) : std::max(0.f, std::min(Value, 1.f));
+		}
+	}
+	return Image;
+}
+
+bool FImage::LoadPFM(const std::string& FileName)
+{
+	std::ifstream File(FileName, std::ios::binary);
+	std::string Format;
+	float Scale = 0.f;
+	if (!(File >> Format >> Width >> Height >> Scale) || Format != "PF" || Width <= 0 || Height <= 0 || Scale >= 0.f)
+	{
+		// Only little endian colour maps are written.
+		return false;
+	}
+	File.get();
+
+	Pixels.resize(size_t(Width) * Height * 3);
+	File.read(reinterpret_cast<char*>(Pixels.data()), Pixels.size() * sizeof(float));
+	return bool(File);
+}
+
+bool FImage::SavePFM(const std::string& FileName) const
+{
+	std::ofstream File(FileName, std::ios::binary | std::ios::trunc);
+	File << "PF\n" << Width << " " << Height << "\n-1.0\n";
+	File.write(reinterpret_cast<const char*>(Pixels.data()), Pixels.size() * sizeof(float));
+	return bool(File);
+}
+
+bool FImage::SavePPM(const std::string& FileName) const
+{
+	std::ofstream File(FileName, std::ios::binary | std::ios::trunc);
+	File << "P6\n" << Width << " " << Height << "\n255\n";
+
+	// PPM rows go top to bottom.
+	std::vector<unsigned char> Row(size_t(Width) * 3);
+	for (int y = Height - 1; y >= 0; --y)
+	{
+		for (size_t i = 0; i < Row.size(); ++i)
+		{
+			Row[i] = static_cast<unsigned char>(std::max(0.f, std::min(Pixels[size_t(y) * Width * 3 + i], 1.f)) * 255.f + 0.5f);
+		}
+		File.write(reinterpret_cast<const char*>(Row.data()), Row.size());
+	}
+	return bool(File);
+}
+
+bool CompareImages(const FImage& Golden, const FImage& Image, FImageDifference& Difference)
+{
+	if (Golden.Width != Image.Width || Golden.Height != Image.Height || Golden.Pixels.size() != Image.Pixels.size())
+	{
+		return false;
+	}
+
+	double SquaredSum = 0.;
+	Difference.MaxError = 0.f;
+	for (size_t i = 0; i < Golden.Pixels.size(); ++i)
+	{
+		const float Error = std::abs(Golden.Pixels[i] - Image.Pixels[i]);
+		SquaredSum += double(Error) * Error;
+		Difference.MaxError = std::max(Difference.MaxError, Error);
+	}
+	Difference.Rmse = float(std::sqrt(SquaredSum / std::max<size_t>(Golden.Pixels.size(), 1)));
+
+	const std::vector<float> GoldenLab = ToLab(Golden);
+	const std::vector<float> ImageLab = ToLab(Image);
+
+	Difference.Heatmap.Width = Image.Width;
+	Difference.Heatmap.Height = Image.Height;
+	Difference.Heatmap.Pixels.assign(Image.Pixels.size(), 0.f);
+
+	double PerceptualSum = 0.;
+	for (int y = 0; y < Image.Height; ++y)
+	{
+		for (int x = 0; x < Image.Width; ++x)
+		{
+			const size_t i = (size_t(y) * Image.Width + x) * 3;
+
+			const float DeltaL = GoldenLab[i] - ImageLab[i];
+			const float DeltaA = GoldenLab[i + 1] - ImageLab[i + 1];
+			const float DeltaB = GoldenLab[i + 2] - ImageLab[i + 2];
+			const float HyAB = std::abs(DeltaL) + std::sqrt(DeltaA * DeltaA + DeltaB * DeltaB);
+
+			const float ColorError = std::min(HyAB / GOLDEN_HYAB_RANGE, 1.f);
+			const float EdgeError = std::abs(GetEdge(GoldenLab, Image.Width, Image.Height, x, y) - GetEdge(ImageLab, Image.Width, Image.Height, x, y));
+			const float Error = ColorError > 0.f ? std::pow(ColorError, 1.f - EdgeError) : 0.f;
+			PerceptualSum += Error;
+
+			Difference.Heatmap.Pixels[i] = std::min(3.f * Error, 1.f);
+			Difference.Heatmap.Pixels[i + 1] = std::max(0.f, std::min(3.f * Error - 1.f, 1.f));
+			Difference.Heatmap.Pixels[i + 2] = std::max(0.f, std::min(3.f * Error - 2.f, 1.f));
+		}
+	}
+	Difference.Perceptual = float(PerceptualSum / std::max(size_t(Image.Width) * Image.Height, size_t(1)));
+
+	return true;
+}
+
+FGoldenImages::FGoldenImages(const std::string& inDirectory, bool bInCapture)
+	:Directory(inDirectory),
+	bCapture(bInCapture)
+{
+	MakeDirectory(Directory);
+	if (!bCapture)
+	{
+		MakeDirectory(Directory + "/Diff");
+	}
+}
+
+bool FGoldenImages::Process(const std::string& Name, const FImage& Image)
+{
+	FResult Result;
+	Result.Name = Name;
+
+	const std::string GoldenPath = Directory + "/" + Name + ".pfm";
+	if (bCapture)
+	{
+		Result.bPassed = Image.SavePFM(GoldenPath);
+		std::cout << (Result.bPassed ? "Captured " : "Failed to write ") << GoldenPath << std::endl;
+	}
+	else
+	{
+		FImage Golden;
+		if (!Golden.LoadPFM(GoldenPath))
+		{
+			std::cout << Name << " : missing golden image " << GoldenPath << std::endl;
+		}
+		else if (!CompareImages(Golden, Image, Result.Difference))
+		{
+			std::cout << Name << " : size differs from the golden image" << std::endl;
+		}
+		else
+		{
+			Result.bPassed = Result.Difference.Passed();
+			Result.Difference.Heatmap.SavePPM(Directory + "/Diff/" + Name + ".ppm");
+			// Heatmaps are large, they are kept on disk only.
+			Result.Difference.Heatmap = FImage();
+
+			std::cout << std::left << std::setw(48) << Name << std::fixed << std::setprecision(5)
+				<< " rmse " << Result.Difference.Rmse << "  max " << Result.Difference.MaxError
+				<< "  perceptual " << Result.Difference.Perceptual << (Result.bPassed ? "  ok" : "  FAILED") << std::endl;
+		}
+
+		if (!Result.bPassed)
+		{
+			Image.SavePFM(Directory + "/Diff/" + Name + ".pfm");
+		}
+	}
+
+	Results.push_back(Result);
+	return Result.bPassed;
+}
+
+int FGoldenImages::Finish()
+{
+	const int Failed = int(std::count_if(Results.begin(), Results.end(), [](const FResult& Result) { return !Result.bPassed; }));
+	if (bCapture)
+	{
+		return Failed;
+	}
+
+	std::ofstream Report(Directory + "/Diff/report.csv");
+	Report << "image,rmse,max_error,perceptual,passed\n";
+	for (const FResult& Result : Results)
+	{
+		Report << Result.Name << "," << Result.Difference.Rmse << "," << Result.Difference.MaxError << ","
+			<< Result.Difference.Perceptual << "," << (Result.bPassed ? 1 : 0) << "\n";
+	}
+
+	std::cout << Results.size() - Failed << " of " << Results.size() << " images match "
+		<< "(thresholds rmse " << GOLDEN_MAX_RMSE << ", max " << GOLDEN_MAX_ERROR << ", perceptual " << GOLDEN_MAX_PERCEPTUAL << ")" << std::endl;
+	return Failed;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Image fails the comparison if any of the metrics is above its threshold.
+#define GOLDEN_MAX_RMSE 0.01f
+#define GOLDEN_MAX_ERROR 0.25f
+#define GOLDEN_MAX_PERCEPTUAL 0.02f
+
+// Float RGB image, rows bottom to top as read from OpenGL.
+struct FImage
+{
+	int Width = 0;
+	int Height = 0;
+	std::vector<float> Pixels;
+
+	// RGBA pixels from glReadPixels, linear color is encoded to sRGB, so all images hold what is displayed.
+	static FImage FromFramebuffer(int inWidth, int inHeight, const std::vector<float>& RGBA, bool bLinear);
+
+	// Portable float map, keeps the exact values.
+	bool LoadPFM(const std::string& FileName);
+	bool SavePFM(const std::string& FileName) const;
+	// 8 bit binary PPM for viewing.
+	bool SavePPM(const std::string& FileName) const;
+};
+
+struct FImageDifference
+{
+	float Rmse = 0.f;
+	// Largest difference of a single channel.
+	float MaxError = 0.f;
+	// Mean of the FLIP-like per pixel error.
+	float Perceptual = 0.f;
+	// Per pixel perceptual error, black to white through red and yellow.
+	FImage Heatmap;
+
+	bool Passed() const { return Rmse <= GOLDEN_MAX_RMSE && MaxError <= GOLDEN_MAX_ERROR && Perceptual <= GOLDEN_MAX_PERCEPTUAL; };
+};
+
+// Returns false if the images differ in size.
+// Perceptual error follows FLIP loosely : both images are blurred, compared as HyAB distance in L*a*b*,
+// and the color error is raised to the power of one minus the difference of edges.
+bool CompareImages(const FImage& Golden, const FImage& Image, FImageDifference& Difference);
+
+// Directory of golden images, capture stores them and compare checks new renders against them.
+// Heatmaps and report.csv of the comparison go to the Diff subdirectory.
+class FGoldenImages
+{
+public:
+
+	FGoldenImages(const std::string& inDirectory, bool bInCapture);
+
+	// Stores or compares the image, returns false if it is missing or fails the thresholds.
+	bool Process(const std::string& Name, const FImage& Image);
+
+	// Writes the report, returns number of failed images.
+	int Finish();
+
+private:
+
+	struct FResult
+	{
+		std::string Name;
+		FImageDifference Difference;
+		bool bPassed = false;
+	};
+
+	std::string Directory;
+	bool bCapture = false;
+	std::vector<FResult> Results;
+};
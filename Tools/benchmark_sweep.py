@@ -0,0 +1,270 @@
+#!/usr/bin/env python3
+"""Parameter sweep over shader x lights x segments x resolution with PBR --benchmark.
+
+Reads a JSON spec (see Tools/sweep.json), runs every combination of its matrix
+headless as a separate process, repetitions times, and writes to the output
+directory :
+
+  runs/*.csv    per frame times of every run, as written by PBR, and a .done
+                marker next to each run that exited successfully
+  results.csv   one row per combination with median of the per run median
+                CPU/GPU frame times and its 95% confidence interval
+  *.svg         GPU time against lights, segments and resolution, one line per
+                shader, the other parameters fixed at their last value in the spec
+
+Runs from the repository root, PBR loads shaders and textures relative to it.
+Finished runs are kept, --resume skips the ones with a .done marker after an
+interrupted sweep and runs the rest again.
+"""
+
+import argparse
+import csv
+import itertools
+import json
+import math
+import os
+import subprocess
+import sys
+
+# Parameters of the matrix and the PBR option setting each of them.
+PARAMETERS = (
+    ("shader", "--shader"),
+    ("lights", "--lights"),
+    ("segments", "--segments"),
+    ("resolution", "--resolution"),
+)
+
+# Axes of the scaling plots, value used as x coordinate and its label.
+PLOTS = (
+    ("lights", lambda value: product_of(value), "Lights"),
+    ("segments", lambda value: int(value), "Sphere segments"),
+    ("resolution", lambda value: product_of(value) / 1e6, "Megapixels"),
+)
+
+COLORS = ("#1f77b4", "#ff7f0e", "#2ca02c", "#d62728", "#9467bd", "#8c564b", "#e377c2", "#7f7f7f")
+
+
+def product_of(size):
+    """'<a>x<b>' -> a * b."""
+    a, b = str(size).split("x")
+    return int(a) * int(b)
+
+
+def median(values):
+    values = sorted(values)
+    middle = len(values) // 2
+    return values[middle] if len(values) % 2 else 0.5 * (values[middle - 1] + values[middle])
+
+
+def median_interval(values, z=1.96):
+    """Distribution free confidence interval of the median from order statistics.
+
+    Frames of one process are correlated, so values are the medians of the
+    independent runs, not the pooled frames. With few runs the interval is
+    their whole range.
+    """
+    values = sorted(values)
+    n = len(values)
+    spread = z * math.sqrt(n) / 2.0
+    low = max(int(math.floor(n / 2.0 - spread)), 0)
+    high = min(int(math.ceil(n / 2.0 + spread)), n - 1)
+    return values[low], values[high]
+
+
+def run_benchmark(spec, combination, output):
+    command = [spec["executable"], "--benchmark", "--output", output,
+               "--context", spec.get("context", "native"),
+               "--scene", spec.get("scene", "study"),
+               "--warmup", str(spec.get("warmup", 60)),
+               "--frames", str(spec.get("frames", 300))]
+    for (name, option), value in zip(PARAMETERS, combination):
+        command += [option, str(value)]
+
+    try:
+        result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True,
+                                timeout=spec.get("timeout", 600))
+    except subprocess.TimeoutExpired:
+        return "timed out"
+    if result.returncode != 0:
+        return "exit code %d\n%s" % (result.returncode, result.stdout)
+    return None
+
+
+def read_run(path):
+    with open(path, newline="") as f:
+        return list(csv.DictReader(f))
+
+
+def summarize(combination, runs):
+    rows = [row for run in runs for row in run]
+    run_cpu = [median([float(row["cpu_ms"]) for row in run]) for run in runs]
+    run_gpu = [median([float(row["gpu_ms"]) for row in run]) for run in runs]
+    width, height = str(combination[3]).split("x")
+
+    summary = {
+        "shader": rows[0]["shader"],
+        "shader_index": combination[0],
+        "lights": product_of(combination[1]),
+        "lights_grid": combination[1],
+        "segments": combination[2],
+        "width": width,
+        "height": height,
+        "repetitions": len(runs),
+        "frames": len(rows),
+        "cpu_median_ms": median(run_cpu),
+        "gpu_median_ms": median(run_gpu),
+        "gpu_run_min_ms": min(run_gpu),
+        "gpu_run_max_ms": max(run_gpu),
+        "renderer": rows[0]["renderer"],
+    }
+    summary["cpu_ci_low_ms"], summary["cpu_ci_high_ms"] = median_interval(run_cpu)
+    summary["gpu_ci_low_ms"], summary["gpu_ci_high_ms"] = median_interval(run_gpu)
+    return summary
+
+
+def write_results(path, results):
+    columns = ["shader", "shader_index", "lights", "lights_grid", "segments", "width", "height", "repetitions", "frames",
+               "cpu_median_ms", "cpu_ci_low_ms", "cpu_ci_high_ms",
+               "gpu_median_ms", "gpu_ci_low_ms", "gpu_ci_high_ms", "gpu_run_min_ms", "gpu_run_max_ms", "renderer"]
+    with open(path, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=columns)
+        writer.writeheader()
+        for result in results:
+            writer.writerow({key: ("%.4f" % value if isinstance(value, float) else value) for key, value in result.items()})
+
+
+def write_plot(path, title, x_label, series, log_x):
+    """Line plot of {name: [(x, median, low, high)]} with confidence intervals as error bars."""
+    width, height = 720, 440
+    left, right, top, bottom = 70, 220, 40, 60
+
+    points = [point for values in series.values() for point in values]
+    x_min, x_max = min(p[0] for p in points), max(p[0] for p in points)
+    y_max = max(p[3] for p in points) * 1.1 or 1.0
+
+    def to_x(value):
+        if log_x:
+            value, low, high = math.log(value), math.log(x_min), math.log(x_max)
+        else:
+            low, high = x_min, x_max
+        return left + (value - low) / ((high - low) or 1.0) * (width - left - right)
+
+    def to_y(value):
+        return height - bottom - value / y_max * (height - top - bottom)
+
+    svg = ['<svg xmlns="http://www.w3.org/2000/svg" width="%d" height="%d" font-family="sans-serif" font-size="12">' % (width, height),
+           '<rect width="100%" height="100%" fill="white"/>',
+           '<text x="%d" y="24" font-size="15">%s</text>' % (left, title),
+           '<text x="%d" y="%d" text-anchor="middle">%s%s</text>' % ((left + width - right) / 2, height - 15, x_label, " (log scale)" if log_x else ""),
+           '<text transform="translate(18,%d) rotate(-90)" text-anchor="middle">GPU ms per frame</text>' % ((top + height - bottom) / 2)]
+
+    for i in range(6):
+        value = y_max * i / 5
+        svg.append('<line x1="%d" x2="%d" y1="%.1f" y2="%.1f" stroke="#ddd"/>' % (left, width - right, to_y(value), to_y(value)))
+        svg.append('<text x="%d" y="%.1f" text-anchor="end">%.2f</text>' % (left - 6, to_y(value) + 4, value))
+    for value in sorted(set(p[0] for p in points)):
+        svg.append('<text x="%.1f" y="%d" text-anchor="middle">%g</text>' % (to_x(value), height - bottom + 18, value))
+    svg.append('<polyline points="%d,%d %d,%d %d,%d" fill="none" stroke="black"/>' % (left, top, left, height - bottom, width - right, height - bottom))
+
+    for index, (name, values) in enumerate(sorted(series.items())):
+        color = COLORS[index % len(COLORS)]
+        values = sorted(values)
+        svg.append('<polyline fill="none" stroke="%s" stroke-width="2" points="%s"/>' % (color, " ".join("%.1f,%.1f" % (to_x(x), to_y(y)) for x, y, _, _ in values)))
+        for x, y, low, high in values:
+            svg.append('<line x1="%.1f" x2="%.1f" y1="%.1f" y2="%.1f" stroke="%s"/>' % (to_x(x), to_x(x), to_y(low), to_y(high), color))
+            svg.append('<circle cx="%.1f" cy="%.1f" r="3" fill="%s"/>' % (to_x(x), to_y(y), color))
+        legend_y = top + 10 + 18 * index
+        svg.append('<rect x="%d" y="%d" width="12" height="12" fill="%s"/>' % (width - right + 15, legend_y - 10, color))
+        svg.append('<text x="%d" y="%d">%s</text>' % (width - right + 32, legend_y, name))
+
+    svg.append("</svg>")
+    with open(path, "w") as f:
+        f.write("\n".join(svg) + "\n")
+
+
+def write_plots(output, matrix, results):
+    for parameter, to_value, label in PLOTS:
+        values = matrix[parameter]
+        if len(values) < 2:
+            continue
+
+        # The other parameters stay at their last value in the spec.
+        fixed = {name: matrix[name][-1] for name, _ in PARAMETERS if name not in ("shader", parameter)}
+        series = {}
+        for result in results:
+            combination = result["combination"]
+            if any(combination[name] != value for name, value in fixed.items()):
+                continue
+            series.setdefault(result["shader"], []).append(
+                (to_value(combination[parameter]), result["gpu_median_ms"], result["gpu_ci_low_ms"], result["gpu_ci_high_ms"]))
+
+        if not series:
+            continue
+        numbers = [to_value(value) for value in values]
+        log_x = min(numbers) > 0 and max(numbers) / min(numbers) >= 10
+        title = "GPU time by %s, %s" % (parameter, ", ".join("%s %s" % item for item in sorted(fixed.items())))
+        write_plot(os.path.join(output, "%s.svg" % parameter), title, label, series, log_x)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("spec", help="JSON sweep spec")
+    parser.add_argument("--output", default="Benchmarks", help="results directory")
+    parser.add_argument("--executable", help="PBR executable, overrides the spec")
+    parser.add_argument("--resume", action="store_true", help="skip runs that already finished successfully")
+    args = parser.parse_args()
+
+    with open(args.spec) as f:
+        spec = json.load(f)
+    if args.executable:
+        spec["executable"] = args.executable
+
+    matrix = spec["matrix"]
+    missing = [name for name, _ in PARAMETERS if not matrix.get(name)]
+    if missing:
+        print("Matrix has no values for : " + ", ".join(missing))
+        return 1
+
+    runs_dir = os.path.join(args.output, "runs")
+    os.makedirs(runs_dir, exist_ok=True)
+
+    combinations = list(itertools.product(*(matrix[name] for name, _ in PARAMETERS)))
+    repetitions = spec.get("repetitions", 3)
+    print("%d combinations x %d repetitions" % (len(combinations), repetitions))
+
+    results, failed = [], 0
+    for index, combination in enumerate(combinations):
+        name = "_".join(str(value) for value in combination)
+        runs = []
+        for repetition in range(repetitions):
+            path = os.path.join(runs_dir, "%s_%d.csv" % (name, repetition))
+            # A CSV without the marker is left by an interrupted or failed run.
+            done = path + ".done"
+            if not (args.resume and os.path.exists(done)):
+                if os.path.exists(done):
+                    os.remove(done)
+                error = run_benchmark(spec, combination, path)
+                if error:
+                    print("%s run %d failed : %s" % (name, repetition, error))
+                    failed += 1
+                    continue
+                open(done, "w").close()
+            runs.append(read_run(path))
+
+        runs = [run for run in runs if run]
+        if not runs:
+            continue
+        result = summarize(combination, runs)
+        print("[%d/%d] %-40s %-36s gpu %8.3f ms  cpu %8.3f ms" % (index + 1, len(combinations), name, result["shader"],
+                                                                     result["gpu_median_ms"], result["cpu_median_ms"]))
+        results.append(dict(result, combination=dict(zip((name for name, _ in PARAMETERS), combination))))
+
+    write_results(os.path.join(args.output, "results.csv"), [{k: v for k, v in r.items() if k != "combination"} for r in results])
+    write_plots(args.output, matrix, results)
+
+    print("Results in %s, %d failed runs" % (args.output, failed))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
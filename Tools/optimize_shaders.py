@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""Offline shader optimisation : glslang -> spirv-opt -> spirv-cross back to GLSL 330.
+
+Run PBR with --dump-shaders first, FShader then writes the preprocessed source
+of every permutation it compiles to ShaderCache/Preprocessed. This script
+optimises each of them into ShaderCache/Optimized under the same name, where
+FShader picks them up instead of the preprocessed source on the next start.
+
+Requires glslangValidator, spirv-opt and spirv-cross (Vulkan SDK) in PATH.
+Prints SPIR-V instruction counts of every shader before and after spirv-opt.
+
+Each generated source is compiled again as plain GLSL 330 before it is
+written, ones that do not compile are skipped and FShader keeps using the
+preprocessed source for them.
+"""
+
+import argparse
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+TOOLS = ("glslangValidator", "spirv-opt", "spirv-cross")
+
+
+def count_instructions(path):
+    """Number of instructions in SPIR-V module, high half of the first word of each is its length."""
+    with open(path, "rb") as f:
+        data = f.read()
+    words = struct.unpack("<%dI" % (len(data) // 4), data)
+    count, i = 0, 5
+    while i < len(words):
+        length = words[i] >> 16
+        if length == 0:
+            break
+        count += 1
+        i += length
+    return count
+
+
+def run(command):
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    if result.returncode != 0:
+        raise RuntimeError(" ".join(command) + "\n" + result.stdout)
+
+
+def strip_varying_locations(path, stage):
+    """Stages are optimised one by one, so locations auto-mapped to the outputs of the vertex shader and
+    the inputs of the fragment shader need not agree. Without them stages match by name, like the sources.
+    Vertex inputs and fragment outputs keep their locations, GLSL 330 has them."""
+    qualifier = "out" if stage == "vert" else "in"
+    with open(path) as f:
+        text = f.read()
+    text = re.sub(r"layout\(location = \d+\) ((?:flat |noperspective |smooth )?%s )" % qualifier, r"\1", text)
+    text = text.replace("#extension GL_ARB_separate_shader_objects : require\n", "")
+    with open(path, "w") as f:
+        f.write(text)
+
+
+def optimize(source, target, work):
+    stage = os.path.splitext(source)[1][1:]
+    spirv = os.path.join(work, "shader.spv")
+    optimized = os.path.join(work, "shader.opt.spv")
+    generated = os.path.join(work, "shader." + stage)
+
+    # OpenGL flavoured SPIR-V, locations and bindings of plain uniforms are assigned automatically.
+    # spirv-cross leaves uniform locations out below GLSL 430 and bindings without 420pack, names are kept,
+    # so the application still finds uniforms by name.
+    run(["glslangValidator", "-G", "--auto-map-locations", "--auto-map-bindings", "-S", stage, "-o", spirv, source])
+    run(["spirv-opt", "-O", spirv, "-o", optimized])
+    run(["spirv-cross", "--version", "330", "--no-es", "--no-420pack-extension", "--output", generated, optimized])
+    strip_varying_locations(generated, stage)
+
+    # Output has to be valid GLSL 330 for the driver, a broken artifact would replace a working source.
+    run(["glslangValidator", "-S", stage, generated])
+    shutil.copyfile(generated, target)
+
+    return count_instructions(spirv), count_instructions(optimized)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--cache", default="ShaderCache", help="shader cache directory of PBR")
+    args = parser.parse_args()
+
+    missing = [tool for tool in TOOLS if shutil.which(tool) is None]
+    if missing:
+        print("Missing tools : " + ", ".join(missing))
+        return 1
+
+    source_dir = os.path.join(args.cache, "Preprocessed")
+    target_dir = os.path.join(args.cache, "Optimized")
+    if not os.path.isdir(source_dir):
+        print("No preprocessed shaders in %s, run PBR with --dump-shaders first" % source_dir)
+        return 1
+    os.makedirs(target_dir, exist_ok=True)
+
+    failed = 0
+    print("%-24s %8s %8s %7s" % ("Shader", "Before", "After", "Saved"))
+    with tempfile.TemporaryDirectory() as work:
+        for name in sorted(os.listdir(source_dir)):
+            try:
+                before, after = optimize(os.path.join(source_dir, name), os.path.join(target_dir, name), work)
+            except RuntimeError as error:
+                # FShader keeps using the preprocessed source of shaders which fail here.
+                print("%-24s failed\n%s" % (name, error))
+                failed += 1
+                continue
+            print("%-24s %8d %8d %6.1f%%" % (name, before, after, 100.0 * (before - after) / max(before, 1)))
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())